@@ -15,6 +15,10 @@
 // PIN DEFINITIONS
 // ============================================================================
 
+// Quadrature encoder pins (optional, B must be A + 1)
+const uint8_t ENCODER_PIN_A = 0;    // GPIO 0 - Phase A
+const uint8_t ENCODER_PIN_B = 1;    // GPIO 1 - Phase B
+
 // Keypad pins (4 rows, 4 columns)
 const uint8_t KEYPAD_ROW_PINS[4] = {2, 3, 4, 5};      // GPIO 2-5
 const uint8_t KEYPAD_COL_PINS[4] = {6, 7, 8, 9};      // GPIO 6-9
@@ -26,14 +30,16 @@ const uint8_t ULTRASONIC_ECHO_PIN = 11;     // GPIO 11
 // Motor driver pins (L298N)
 const uint8_t MOTOR_IN1_PIN = 12;   // GPIO 12 - Direction control 1
 const uint8_t MOTOR_IN2_PIN = 13;   // GPIO 13 - Direction control 2
-const uint8_t MOTOR_ENA_PIN = 14;   // GPIO 14 - PWM speed control
+const uint8_t MOTOR_ENA_PIN = 14;   // GPIO 14 - PWM speed control, slice 7A
 
 // Servo pins
-const uint8_t SERVO_BOX_PIN = 15;        // GPIO 15 - Opens piece box bottom (MG996)
-const uint8_t SERVO_BOARD_LID_PIN = 16;  // GPIO 16 - Opens game board bottom lid
+// Both servos share PWM slice 0 (50Hz); the motor ENA has slice 7 to itself
+// so its PWM frequency is not overwritten by the servo setup.
+const uint8_t SERVO_BOX_PIN = 17;        // GPIO 17 - Opens piece box bottom (MG996), slice 0B
+const uint8_t SERVO_BOARD_LID_PIN = 16;  // GPIO 16 - Opens game board bottom lid, slice 0A
 
 // Game button pins (6 buttons total)
-const uint8_t BUTTON_COLUMN_1_PIN = 17;   // GPIO 17 - Select Column 1
+const uint8_t BUTTON_COLUMN_1_PIN = 15;   // GPIO 15 - Select Column 1
 const uint8_t BUTTON_COLUMN_2_PIN = 18;   // GPIO 18 - Select Column 2
 const uint8_t BUTTON_COLUMN_3_PIN = 19;   // GPIO 19 - Select Column 3
 const uint8_t BUTTON_DROP_PIN = 20;       // GPIO 20 - Execute drop
@@ -43,6 +49,12 @@ const uint8_t BUTTON_START_OVER_PIN = 22; // GPIO 22 - Start over/Reset game
 // Buzzer pin
 const uint8_t BUZZER_PIN = 26;  // GPIO 26
 
+// Motor current sense (optional, L298N SENSE A pin)
+const uint8_t MOTOR_SENSE_PIN = 27;   // GPIO 27 - ADC1
+
+// Home limit switch (optional, normally open to ground)
+const uint8_t LIMIT_SWITCH_PIN = 28;  // GPIO 28
+
 // ============================================================================
 // GAME CONFIGURATION
 // ============================================================================
@@ -51,7 +63,8 @@ const uint8_t BUZZER_PIN = 26;  // GPIO 26
 const char UNLOCK_CODE[5] = "1111";  // Temporary: Changed due to keypad reading 4x per press
 
 // Column positions (distance from ultrasonic sensor in cm)
-// NOTE: Adjust these values based on your physical setup!
+// Defaults only: the rail calibration (hold Start Over at power-up)
+// measures the real stops and stores them in flash.
 const float COLUMN_1_DISTANCE_CM = 5.0f;   // Distance to Column 1 (5cm from sensor)
 const float COLUMN_2_DISTANCE_CM = 10.0f;  // Distance to Column 2 (5cm from Col1)
 const float COLUMN_3_DISTANCE_CM = 15.0f;  // Distance to Column 3 (5cm from Col2)
@@ -59,19 +72,112 @@ const float HOME_POSITION_CM = 2.0f;       // Home position distance
 
 // Distance tolerance for positioning (cm)
 const float DISTANCE_TOLERANCE_CM = 0.5f;
+const float DISTANCE_TOLERANCE_CALIBRATED_CM = 0.2f;  // Used once a sensor calibration is loaded
+
+// Ultrasonic range gating (cm)
+const float ULTRASONIC_MAX_RANGE_CM = 20.0f;    // Rail end + margin (sensor max is 400cm)
+const float ULTRASONIC_WINDOW_MARGIN_CM = 3.0f; // Slack around expected position while moving
+const float ULTRASONIC_OVERSHOOT_MARGIN_CM = 10.0f; // Extra slack past the target (overshoot must stay visible)
+
+// Distance filter (median -> outlier gate -> alpha-beta)
+const float FILTER_ALPHA = 0.5f;           // Position correction gain
+const float FILTER_BETA = 0.2f;            // Velocity correction gain
+const float FILTER_MAX_JUMP_CM = 2.0f;     // Reject samples further than this from prediction
+const float FILTER_MIN_CONFIDENCE = 0.6f;  // Minimum confidence to act on the estimate
 
-// Motor calibration
+// Motor calibration (defaults, replaced by the rail calibration)
 const uint8_t MOTOR_SPEED = 70;      // Motor speed (0-100%)
 const uint32_t MOTOR_TIMEOUT_MS = 10000;  // Safety timeout for motor movement
+const uint8_t MOTOR_MIN_SPEED = 30;  // Lowest speed that still moves the carriage (0-100%)
+const uint16_t MOTOR_RAMP_RATE = 500;  // Duty slew rate (% per second, 0 = instant)
+const bool MOTOR_SHORT_BRAKE = true;   // Stop by shorting the motor (false = coast)
+
+// Motor current sense (stall / overload detection)
+const bool CURRENT_SENSE_INSTALLED = false;  // Set true once SENSE A has a resistor to GND
+const float MOTOR_SENSE_OHMS = 0.5f;         // Sense resistor
+const uint16_t MOTOR_OVERCURRENT_MA = 1800;  // Cut at once (L298N limit is 2A)
+const uint16_t MOTOR_STALL_MA = 900;         // Stall current of the rail motor...
+const uint32_t MOTOR_STALL_MS = 40;          // ...held this long (longer than start-up inrush)
+
+// Position controller (PID on filtered distance, output in % speed)
+const float POSITION_KP = 8.0f;               // % per cm of error
+const float POSITION_KI = 2.0f;               // % per cm*s of accumulated error
+const float POSITION_KD = 1.5f;               // % per cm/s of velocity (damping)
+const float POSITION_KFF = 5.0f;              // % per cm/s of planned velocity (feedforward)
+const float POSITION_SLOWDOWN_CM = 4.0f;      // Speed limit ramps down inside this distance
+const float POSITION_SETTLE_VELOCITY_CM_S = 1.0f;  // Considered stationary below this
+const uint32_t POSITION_SETTLE_MS = 150;      // Must stay in tolerance this long
+const float STOP_MODEL_MAX_SPEED_CM_S = 14.0f; // Speed covered by the learned stop distances
+const float STOP_MODEL_LEARNING_RATE = 0.3f;   // Fraction of stop-distance error learned per stop
+
+// Limit-switch homing (fast approach, back off, slow re-approach)
+const bool LIMIT_SWITCH_INSTALLED = false;     // Set true once the home switch is fitted
+const float LIMIT_SWITCH_POSITION_CM = 1.5f;   // Carriage position when the switch closes
+const uint8_t HOMING_FAST_SPEED = 80;          // First approach (0-100%)
+const uint8_t HOMING_SLOW_SPEED = 35;          // Back-off and re-approach (0-100%)
+const uint32_t HOMING_BACKOFF_MS = 150;        // Keep backing off this long after the switch opens
+
+// Encoder (fused with ultrasonic for kHz-rate position control)
+const bool ENCODER_INSTALLED = false;          // Set true once an encoder is fitted
+const float ENCODER_CM_PER_COUNT = 4.0f / 2400.0f;  // 20T GT2 pulley, 600 PPR x4 (negative reverses)
+const float ENCODER_FUSION_GAIN = 0.05f;       // Fraction of ultrasonic error corrected per ping
+
+// Dead-reckoning observer (predicts position between pings when no encoder)
+const float OBSERVER_POSITION_GAIN = 0.5f;     // Fraction of position error corrected per ping
+const float OBSERVER_VELOCITY_GAIN = 0.3f;     // Fraction of velocity error corrected per ping
+const float OBSERVER_LEARNING_RATE = 0.05f;    // Model gain adaptation per ping (0 = off)
+const uint8_t OBSERVER_MAX_BLIND_PINGS = 5;     // Hold still after this many pings without a trusted reading
+const float MOTOR_CM_S_PER_PERCENT = 0.25f;    // Initial model: velocity per % duty above MOTOR_MIN_SPEED
+const uint32_t MOTOR_TIME_CONSTANT_MS = 80;    // Motor velocity lag
+
+// High-rate control step period (encoder or observer, 1 kHz)
+const uint32_t CONTROL_PERIOD_US = 1000;
+
+// Motion profile limits (S-curve between stops, jerk 0 = trapezoidal)
+const float MOTION_MAX_VELOCITY_CM_S = 10.0f;
+const float MOTION_MAX_ACCEL_CM_S2 = 40.0f;
+const float MOTION_MAX_JERK_CM_S3 = 400.0f;
+
+// Sensor calibration (hold Confirm at power-up to run the guided capture)
+const uint8_t FLASH_SECTOR_SENSOR_CAL = 0;   // Flash sector from end of flash
+const uint8_t CALIBRATION_JOG_SPEED = 40;    // Motor speed while jogging to a stop (0-100%)
+const uint8_t CALIBRATION_SAMPLES = 16;      // Echoes averaged per calibration point
+
+// Rail calibration (hold Start Over at power-up to run the sweep)
+const uint8_t FLASH_SECTOR_RAIL_CAL = 1;         // Flash sector from end of flash
+const float RAIL_CAL_MOVE_THRESHOLD_CM = 0.3f;   // Movement that counts as "started"
+const uint32_t RAIL_CAL_DUTY_STEP_MS = 100;      // Time per 1% duty step when finding min duty
+const uint8_t RAIL_CAL_DUTY_INCREMENT = 10;      // Duty step of the velocity sweep (%)
+const uint8_t RAIL_CAL_MAX_POINTS = 10;          // Velocity sweep points
+const uint32_t RAIL_CAL_SETTLE_MS = 150;         // Ignore spin-up before measuring velocity
+const uint8_t RAIL_CAL_MIN_SAMPLES = 4;          // Pings needed for a velocity measurement
+const uint8_t MOTOR_SPEED_HEADROOM = 15;         // Duty above cruise left for corrections (%)
+
+// Servos
+// Speed/settle figures are untuned placeholders, not measured on the
+// fitted servos. To tune, step 0° -> 90° with setAngle() and time the
+// horn on slow-motion video.
+const bool SERVO_FRAME_SYNC = true;           // Advance servo moves from the PWM wrap IRQ
+const uint32_t SERVO_AUTO_DETACH_MS = 1500;   // Stop pulses once a servo has held still this long
 
 // Servo #1 - Piece box bottom (drop gate)
 const float BOX_OPEN_ANGLE = 90.0f;       // Box gate open (piece drops)
 const float BOX_CLOSED_ANGLE = 0.0f;      // Box gate closed
 const uint32_t BOX_DROP_TIME_MS = 5000;   // Keep gate open for 5 seconds
+const uint16_t BOX_SERVO_SPEED_DEG_S = 250;  // Slew speed with the gate loaded (untuned default)
+const uint16_t BOX_SERVO_SETTLE_MS = 80;     // Settle time at the end stop (untuned default)
+const uint16_t BOX_SERVO_PULSE_0_US = 500;   // Pulse width reaching 0° (calibrate per servo)
+const uint16_t BOX_SERVO_PULSE_90_US = 1500; // Pulse width reaching 90°
+const uint16_t BOX_SERVO_PULSE_180_US = 2500; // Pulse width reaching 180°
 
 // Servo #2 - Board bottom lid (reset/clear all pieces)
 const float LID_OPEN_ANGLE = 90.0f;       // Board lid open (clear all pieces)
 const float LID_CLOSED_ANGLE = 0.0f;      // Board lid closed
+const uint16_t LID_SERVO_SPEED_DEG_S = 180;  // Slew speed with the lid loaded (untuned default)
+const uint16_t LID_SERVO_SETTLE_MS = 120;    // Settle time at the end stop (untuned default)
+const uint16_t LID_SERVO_PULSE_0_US = 500;   // Pulse width reaching 0° (calibrate per servo)
+const uint16_t LID_SERVO_PULSE_90_US = 1500; // Pulse width reaching 90°
+const uint16_t LID_SERVO_PULSE_180_US = 2500; // Pulse width reaching 180°
 
 // Game rules
 const uint8_t MAX_PIECES_PER_COLUMN = 3;  // 3 pieces per column
@@ -80,7 +186,10 @@ const uint8_t TOTAL_PIECES = 9;           // Total 9 pieces (3x3)
 
 // Timing constants
 const uint32_t DEBOUNCE_TIME_MS = 50;
+const bool BUTTON_IRQ_MODE = true;                 // Timestamp button edges in the GPIO IRQ
 const uint32_t BUZZER_SUCCESS_DURATION_MS = 2000;
+const uint32_t ULTRASONIC_PING_INTERVAL_MS = 20;   // Time between position pings while moving
+const uint32_t MOTION_TELEMETRY_INTERVAL_MS = 200; // Position printout interval while moving
 
 // ============================================================================
 // STATE MACHINE
@@ -92,6 +201,7 @@ enum GameState {
     STATE_UNLOCKED,          // Code entered, waiting for Start button
     STATE_IDLE,              // Ready for column selection
     STATE_MOVING_TO_COLUMN,  // Motor moving box to selected column
+    STATE_RETURNING_HOME,    // Motor returning box home after a failed move
     STATE_POSITIONED,        // Box positioned, waiting for Drop button
     STATE_DROPPING,          // Drop servo opening/closing
     STATE_COMPLETE,          // All 9 pieces dropped, waiting for Confirm/Start Over
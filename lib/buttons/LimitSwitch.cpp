@@ -0,0 +1,68 @@
+/**
+ * @file LimitSwitch.cpp
+ * @brief Implementation of interrupt-latched limit switch
+ */
+
+#include "LimitSwitch.h"
+#include "GpioIrq.h"
+#include "hardware/gpio.h"
+
+LimitSwitch::LimitSwitch(uint8_t pin, bool pull_up)
+    : pin_(pin), pull_up_(pull_up),
+      triggered_(false), trigger_time_us_(0),
+      callback_(nullptr), callback_user_data_(nullptr) {
+}
+
+void LimitSwitch::init() {
+    gpio_init(pin_);
+    gpio_set_dir(pin_, GPIO_IN);
+    
+    if (pull_up_) {
+        gpio_pull_up(pin_);
+    } else {
+        gpio_pull_down(pin_);
+    }
+    
+    // Register for edge interrupts (enabled only while armed)
+    GpioIrq::attach(pin_, closingEdge(), onGpioEdge, this);
+}
+
+bool LimitSwitch::isPressed() const {
+    return gpio_get(pin_) != pull_up_;
+}
+
+void LimitSwitch::arm() {
+    gpio_set_irq_enabled(pin_, closingEdge(), false);
+    gpio_acknowledge_irq(pin_, closingEdge());
+    triggered_ = false;
+    gpio_set_irq_enabled(pin_, closingEdge(), true);
+}
+
+void LimitSwitch::disarm() {
+    gpio_set_irq_enabled(pin_, closingEdge(), false);
+}
+
+void LimitSwitch::setCallback(TriggerCallback callback, void* user_data) {
+    callback_ = callback;
+    callback_user_data_ = user_data;
+}
+
+uint32_t LimitSwitch::closingEdge() const {
+    return pull_up_ ? GPIO_IRQ_EDGE_FALL : GPIO_IRQ_EDGE_RISE;
+}
+
+void LimitSwitch::handleEdge(uint32_t timestamp_us) {
+    // One-shot: bounce after the first contact is ignored until re-armed
+    gpio_set_irq_enabled(pin_, closingEdge(), false);
+    
+    trigger_time_us_ = timestamp_us;
+    triggered_ = true;
+    
+    if (callback_ != nullptr) {
+        callback_(callback_user_data_);
+    }
+}
+
+void LimitSwitch::onGpioEdge(void* user_data, uint32_t events, uint32_t timestamp_us) {
+    static_cast<LimitSwitch*>(user_data)->handleEdge(timestamp_us);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file LimitSwitch.h
+ * @brief Interrupt-latched limit switch for homing
+ * 
+ * Pin Configuration:
+ * - Switch: GPIO input with pull-up resistor, other side to ground
+ *   (normally open, closes when the carriage reaches it)
+ * 
+ * Latching:
+ * - arm() enables an interrupt on the closing edge
+ * - The first edge is timestamped and latched in the IRQ, the interrupt
+ *   disables itself (contact bounce is ignored) and the trigger callback
+ *   runs right away, e.g. to brake the motor with sub-millisecond latency
+ * - The latch stays set until the next arm()
+ * - Edges come from the shared GpioIrq dispatcher
+ */
+
+#ifndef LIMITSWITCH_H
+#define LIMITSWITCH_H
+
+#include "pico/stdlib.h"
+#include <cstdint>
+
+class LimitSwitch {
+public:
+    /**
+     * @brief Callback invoked from the IRQ when the switch closes
+     * Keep it short and interrupt-safe.
+     * @param user_data Pointer passed to setCallback()
+     */
+    typedef void (*TriggerCallback)(void* user_data);
+    
+    /**
+     * @brief Constructor for limit switch
+     * @param pin GPIO pin for the switch
+     * @param pull_up Enable internal pull-up resistor (default true)
+     */
+    LimitSwitch(uint8_t pin, bool pull_up = true);
+    
+    /**
+     * @brief Initialize switch GPIO and interrupt
+     */
+    void init();
+    
+    /**
+     * @brief Read the switch level directly (not debounced)
+     * @return true if the switch is closed
+     */
+    bool isPressed() const;
+    
+    /**
+     * @brief Clear the latch and wait for the next closing edge
+     */
+    void arm();
+    
+    /**
+     * @brief Stop waiting for an edge (latch is kept)
+     */
+    void disarm();
+    
+    /**
+     * @brief Check if the switch closed since arm()
+     * @return true once the closing edge was latched
+     */
+    bool isTriggered() const { return triggered_; }
+    
+    /**
+     * @brief Get time of the latched edge
+     * @return Timestamp in microseconds (valid when isTriggered())
+     */
+    uint32_t getTriggerTimeUs() const { return trigger_time_us_; }
+    
+    /**
+     * @brief Set trigger callback (called from the IRQ)
+     * @param callback Function to call, or nullptr to disable
+     * @param user_data Pointer passed back to the callback
+     */
+    void setCallback(TriggerCallback callback, void* user_data = nullptr);
+    
+private:
+    uint8_t pin_;
+    bool pull_up_;
+    
+    volatile bool triggered_;
+    volatile uint32_t trigger_time_us_;
+    TriggerCallback callback_;
+    void* callback_user_data_;
+    
+    /**
+     * @brief GPIO edge event for the closing level
+     * @return GPIO_IRQ_EDGE_FALL with pull-up, GPIO_IRQ_EDGE_RISE otherwise
+     */
+    uint32_t closingEdge() const;
+    
+    /**
+     * @brief Latch an edge (called from IRQ)
+     * @param timestamp_us Edge time in microseconds
+     */
+    void handleEdge(uint32_t timestamp_us);
+    
+    /**
+     * @brief GPIO edge callback (see GpioIrq)
+     * @param user_data LimitSwitch instance
+     * @param events Pending closing-edge events
+     * @param timestamp_us Edge time in microseconds
+     */
+    static void onGpioEdge(void* user_data, uint32_t events, uint32_t timestamp_us);
+};
+
+#endif // LIMITSWITCH_H
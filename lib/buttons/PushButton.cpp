@@ -4,11 +4,18 @@
  */
 
 #include "PushButton.h"
+#include "GpioIrq.h"
+#include "hardware/gpio.h"
+
+static constexpr uint32_t EDGE_EVENTS = GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL;
 
 PushButton::PushButton(uint8_t pin, bool pull_up)
     : pin_(pin), pull_up_(pull_up),
       current_state_(false), last_state_(false), debounced_state_(false),
-      last_change_time_(0), press_event_(false), release_event_(false) {
+      last_change_time_(0), press_pending_(false), release_pending_(false),
+      press_time_us_(0), release_time_us_(0), discard_before_us_(0), discarding_(false),
+      edge_queue_(), edge_head_(0), edge_tail_(0), edge_overflow_(false), irq_mode_(false),
+      raw_pressed_(false), settling_(false), raw_change_us_(0), burst_start_us_(0) {
 }
 
 void PushButton::init() {
@@ -28,27 +35,87 @@ void PushButton::init() {
     last_change_time_ = to_ms_since_boot(get_absolute_time());
 }
 
+void PushButton::setIrqMode(bool enabled) {
+    if (enabled == irq_mode_) {
+        return;
+    }
+    
+    if (!enabled) {
+        GpioIrq::detach(pin_);
+        irq_mode_ = false;
+        
+        // Resume polling from the debounced state
+        last_state_ = debounced_state_;
+        last_change_time_ = to_ms_since_boot(get_absolute_time());
+        return;
+    }
+    
+    // Register for edge interrupts
+    GpioIrq::attach(pin_, EDGE_EVENTS, onGpioEdge, this);
+    
+    edge_head_ = 0;
+    edge_tail_ = 0;
+    edge_overflow_ = false;
+    raw_pressed_ = debounced_state_;
+    settling_ = false;
+    irq_mode_ = true;
+    
+    gpio_acknowledge_irq(pin_, EDGE_EVENTS);
+    gpio_set_irq_enabled(pin_, EDGE_EVENTS, true);
+    
+    // A change since the last poll produced no edge: debounce it from now
+    if (readRaw() != debounced_state_) {
+        raw_pressed_ = !debounced_state_;
+        raw_change_us_ = time_us_32();
+        burst_start_us_ = raw_change_us_;
+        settling_ = true;
+    }
+}
+
 bool PushButton::isPressed() {
+    if (irq_mode_) {
+        resolveEdges();
+    }
     return debounced_state_;
 }
 
 bool PushButton::wasPressed() {
-    if (press_event_) {
-        press_event_ = false;
-        return true;
+    if (irq_mode_) {
+        resolveEdges();
     }
-    return false;
+    
+    bool pressed = press_pending_;
+    press_pending_ = false;
+    return pressed;
 }
 
 bool PushButton::wasReleased() {
-    if (release_event_) {
-        release_event_ = false;
-        return true;
+    if (irq_mode_) {
+        resolveEdges();
     }
-    return false;
+    
+    bool released = release_pending_;
+    release_pending_ = false;
+    return released;
+}
+
+void PushButton::clearEvents() {
+    if (irq_mode_) {
+        resolveEdges();
+    }
+    
+    press_pending_ = false;
+    release_pending_ = false;
+    discard_before_us_ = time_us_32();
+    discarding_ = true;
 }
 
 void PushButton::update() {
+    if (irq_mode_) {
+        resolveEdges();
+        return;
+    }
+    
     current_state_ = readRaw();
     uint32_t current_time = to_ms_since_boot(get_absolute_time());
     
@@ -62,16 +129,14 @@ void PushButton::update() {
     if ((current_time - last_change_time_) >= DEBOUNCE_TIME_MS) {
         if (current_state_ != debounced_state_) {
             // State has changed after debounce period
-            debounced_state_ = current_state_;
-            
-            // Set edge events
-            if (debounced_state_) {
-                press_event_ = true;
-            } else {
-                release_event_ = true;
-            }
+            commitState(current_state_, last_change_time_ * 1000u);
         }
     }
+    
+    // Any later change starts after clearEvents()
+    if (discarding_ && current_state_ == debounced_state_) {
+        discarding_ = false;
+    }
 }
 
 void PushButton::waitForPress() {
@@ -97,3 +162,98 @@ bool PushButton::readRaw() {
         return gpio_get(pin_);
     }
 }
+
+void PushButton::commitState(bool pressed, uint32_t timestamp_us) {
+    if (pressed == debounced_state_) {
+        return;  // Bounced back to where it was
+    }
+    
+    debounced_state_ = pressed;
+    
+    if (discarding_ && (int32_t)(timestamp_us - discard_before_us_) < 0) {
+        return;  // Started before clearEvents()
+    }
+    
+    // Set edge events (one pending each; repeats are not replayed)
+    if (pressed) {
+        press_pending_ = true;
+        press_time_us_ = timestamp_us;
+    } else {
+        release_pending_ = true;
+        release_time_us_ = timestamp_us;
+    }
+}
+
+void PushButton::resolveEdges() {
+    if (edge_overflow_) {
+        // Edges were dropped: drop the rest and resync from the pin
+        edge_overflow_ = false;
+        edge_tail_ = edge_head_;
+        
+        uint32_t now = time_us_32();
+        if (!settling_) {
+            burst_start_us_ = now;
+        }
+        raw_pressed_ = readRaw();
+        raw_change_us_ = now;
+        settling_ = true;
+    }
+    
+    while (edge_tail_ != edge_head_) {
+        uint32_t edge = edge_queue_[edge_tail_];
+        edge_tail_ = (edge_tail_ + 1) & (EDGE_QUEUE_SIZE - 1);
+        
+        uint32_t timestamp_us = edge & ~1u;
+        
+        // The previous level held long enough before this edge
+        if (settling_ && (timestamp_us - raw_change_us_) >= DEBOUNCE_TIME_US) {
+            commitState(raw_pressed_, burst_start_us_);
+            settling_ = false;
+        }
+        
+        if (!settling_) {
+            burst_start_us_ = timestamp_us;  // First edge of a new burst
+            settling_ = true;
+        }
+        raw_pressed_ = (edge & 1u) != 0;
+        raw_change_us_ = timestamp_us;
+    }
+    
+    // The latest level has been stable since its edge
+    if (settling_ && (time_us_32() - raw_change_us_) >= DEBOUNCE_TIME_US) {
+        commitState(raw_pressed_, burst_start_us_);
+        settling_ = false;
+    }
+    
+    // Any later burst starts after clearEvents()
+    if (!settling_) {
+        discarding_ = false;
+    }
+}
+
+void PushButton::handleEdge(uint32_t events, uint32_t timestamp_us) {
+    // Both edges pending means the pin bounced within one IRQ latency
+    bool high;
+    if (events == GPIO_IRQ_EDGE_RISE) {
+        high = true;
+    } else if (events == GPIO_IRQ_EDGE_FALL) {
+        high = false;
+    } else {
+        high = gpio_get(pin_);
+    }
+    bool pressed = high != pull_up_;
+    
+    uint8_t next = (edge_head_ + 1) & (EDGE_QUEUE_SIZE - 1);
+    if (next == edge_tail_) {
+        edge_overflow_ = true;  // Full: the reader resyncs from the pin
+        return;
+    }
+    
+    // Bit 0 of the timestamp carries the level (1µs is below debounce resolution)
+    edge_queue_[edge_head_] = (timestamp_us & ~1u) | (pressed ? 1u : 0u);
+    edge_head_ = next;
+}
+
+void PushButton::onGpioEdge(void* user_data, uint32_t events, uint32_t timestamp_us) {
+    static_cast<PushButton*>(user_data)->handleEdge(events, timestamp_us);
+}
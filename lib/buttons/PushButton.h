@@ -12,6 +12,19 @@
  * Logic:
  * - Pressed: LOW (0)
  * - Released: HIGH (1)
+ * 
+ * IRQ Mode (setIrqMode):
+ * - GPIO edge interrupts timestamp every raw transition into a small
+ *   lock-free queue (the IRQ writes the head, the reader the tail)
+ * - Debounce is resolved from the timestamps when the button is read: a
+ *   level counts once it was stable for the debounce time, and the event
+ *   is stamped with the first edge of its bounce burst
+ * - A press made while the main loop is blocked is kept (at most one
+ *   pending press, so a burst of presses cannot replay into later game
+ *   states), and nothing has to poll the pin
+ * - clearEvents() drops a press that is pending or still debouncing, so
+ *   a state that starts listening only sees presses made after it began
+ * - Edges come from the shared GpioIrq dispatcher
  */
 
 #ifndef PUSHBUTTON_H
@@ -34,6 +47,13 @@ public:
      */
     void init();
     
+    /**
+     * @brief Switch between polling and edge-interrupt debouncing
+     * Call after init().
+     * @param enabled true for IRQ mode
+     */
+    void setIrqMode(bool enabled);
+    
     /**
      * @brief Read current button state (debounced)
      * @return true if button is pressed
@@ -42,19 +62,41 @@ public:
     
     /**
      * @brief Check if button was just pressed (rising edge)
+     * Consumes the pending press; repeated presses are merged into one.
      * @return true on press event
      */
     bool wasPressed();
     
     /**
      * @brief Check if button was just released (falling edge)
+     * Consumes the pending release.
      * @return true on release event
      */
     bool wasReleased();
     
+    /**
+     * @brief Drop pending press/release events
+     * Events whose first edge came before this call are discarded, even
+     * if they are still being debounced.
+     */
+    void clearEvents();
+    
+    /**
+     * @brief Get time of the latest press
+     * @return Timestamp in microseconds (first edge in IRQ mode)
+     */
+    uint32_t getPressTimeUs() const { return press_time_us_; }
+    
+    /**
+     * @brief Get time of the latest release
+     * @return Timestamp in microseconds (first edge in IRQ mode)
+     */
+    uint32_t getReleaseTimeUs() const { return release_time_us_; }
+    
     /**
      * @brief Update button state (call in main loop)
-     * Must be called regularly for debouncing and edge detection
+     * Must be called regularly for debouncing and edge detection in
+     * polling mode; in IRQ mode it only resolves queued edges.
      */
     void update();
     
@@ -77,16 +119,60 @@ private:
     bool debounced_state_;
     
     uint32_t last_change_time_;
-    bool press_event_;
-    bool release_event_;
+    bool press_pending_;           // Pressed since the last wasPressed()
+    bool release_pending_;         // Released since the last wasReleased()
+    uint32_t press_time_us_;
+    uint32_t release_time_us_;
+    uint32_t discard_before_us_;   // Events stamped earlier are dropped...
+    bool discarding_;              // ...while a change from then may be in flight
+    
+    // IRQ mode: raw edges, time_us with bit 0 = pressed
+    static constexpr uint8_t EDGE_QUEUE_SIZE = 32;  // Power of two
+    volatile uint32_t edge_queue_[EDGE_QUEUE_SIZE];
+    volatile uint8_t edge_head_;   // Written by the IRQ
+    volatile uint8_t edge_tail_;   // Written by the reader
+    volatile bool edge_overflow_;
+    bool irq_mode_;
+    bool raw_pressed_;             // Level after the latest queued edge
+    bool settling_;                // Edges seen since the level was resolved
+    uint32_t raw_change_us_;
+    uint32_t burst_start_us_;
     
     static constexpr uint32_t DEBOUNCE_TIME_MS = 50;
+    static constexpr uint32_t DEBOUNCE_TIME_US = DEBOUNCE_TIME_MS * 1000;
     
     /**
      * @brief Read raw button state
      * @return Raw GPIO state
      */
     bool readRaw();
+    
+    /**
+     * @brief Accept a new debounced state and record its event
+     * @param pressed New state
+     * @param timestamp_us Event time in microseconds
+     */
+    void commitState(bool pressed, uint32_t timestamp_us);
+    
+    /**
+     * @brief Debounce the queued edges (IRQ mode)
+     */
+    void resolveEdges();
+    
+    /**
+     * @brief Queue a raw edge (called from IRQ)
+     * @param events GPIO edge events
+     * @param timestamp_us Edge time in microseconds
+     */
+    void handleEdge(uint32_t events, uint32_t timestamp_us);
+    
+    /**
+     * @brief GPIO edge callback (see GpioIrq)
+     * @param user_data PushButton instance
+     * @param events GPIO edge events
+     * @param timestamp_us Edge time in microseconds
+     */
+    static void onGpioEdge(void* user_data, uint32_t events, uint32_t timestamp_us);
 };
 
 #endif // PUSHBUTTON_H
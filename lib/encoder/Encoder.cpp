@@ -0,0 +1,78 @@
+/**
+ * @file Encoder.cpp
+ * @brief Implementation of PIO quadrature encoder driver
+ */
+
+#include "Encoder.h"
+#include "hardware/clocks.h"
+#include "quadrature_encoder.pio.h"
+
+Encoder::Encoder(uint8_t pin_a, PIO pio)
+    : pin_a_(pin_a), pio_(pio), sm_(0), offset_(0), initialized_(false) {
+}
+
+bool Encoder::init(uint32_t max_step_rate) {
+    // Jump table needs the program at offset 0
+    if (!pio_can_add_program_at_offset(pio_, &quadrature_encoder_program, 0)) {
+        return false;
+    }
+    
+    int sm = pio_claim_unused_sm(pio_, false);
+    if (sm < 0) {
+        return false;
+    }
+    sm_ = (uint)sm;
+    
+    pio_add_program_at_offset(pio_, &quadrature_encoder_program, 0);
+    
+    // Encoder outputs are usually open collector
+    for (uint8_t pin = pin_a_; pin <= pin_a_ + 1; pin++) {
+        pio_gpio_init(pio_, pin);
+        gpio_pull_up(pin);
+    }
+    pio_sm_set_consecutive_pindirs(pio_, sm_, pin_a_, 2, false);
+    
+    pio_sm_config c = quadrature_encoder_program_get_default_config(0);
+    sm_config_set_in_pins(&c, pin_a_);
+    sm_config_set_in_shift(&c, false, false, 32);   // Shift left, no autopush
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    
+    // One loop takes at most 10 cycles
+    if (max_step_rate == 0) {
+        sm_config_set_clkdiv(&c, 1.0f);
+    } else {
+        float div = (float)clock_get_hz(clk_sys) / (10.0f * max_step_rate);
+        sm_config_set_clkdiv(&c, div < 1.0f ? 1.0f : div);
+    }
+    
+    pio_sm_init(pio_, sm_, 0, &c);
+    pio_sm_set_enabled(pio_, sm_, true);
+    initialized_ = true;
+    
+    reset();
+    return true;
+}
+
+int32_t Encoder::getCount() {
+    return readRaw() - offset_;
+}
+
+void Encoder::reset(int32_t count) {
+    offset_ = readRaw() - count;
+}
+
+int32_t Encoder::readRaw() {
+    if (!initialized_) {
+        return 0;
+    }
+    
+    // Drain stale values, then wait for one fresh push (a few cycles away)
+    uint n = pio_sm_get_rx_fifo_level(pio_, sm_) + 1;
+    uint32_t value = 0;
+    while (n > 0) {
+        value = pio_sm_get_blocking(pio_, sm_);
+        n--;
+    }
+    
+    return (int32_t)value;
+}
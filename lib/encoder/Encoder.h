@@ -0,0 +1,67 @@
+/**
+ * @file Encoder.h
+ * @brief PIO quadrature encoder driver for Raspberry Pi Pico
+ * 
+ * A PIO state machine decodes the A/B signals and keeps a 32-bit count,
+ * pushing it to the RX FIFO continuously. Reading the count costs a few
+ * FIFO reads and no interrupts, at any time and any rate.
+ * 
+ * Pin Configuration:
+ * - A: pin_a (input, pulled up)
+ * - B: pin_a + 1 (input, pulled up) - must be consecutive
+ * 
+ * Note: The PIO program uses a computed jump table and must be loaded at
+ * offset 0 of its PIO block, so use a block whose offset 0 is free
+ * (default pio1; pio0 holds the HC-SR04 program when UltrasonicRanger is used).
+ */
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include <cstdint>
+
+class Encoder {
+public:
+    /**
+     * @brief Constructor for quadrature encoder
+     * @param pin_a GPIO pin for phase A (phase B is pin_a + 1)
+     * @param pio PIO block to run the state machine on (default pio1)
+     */
+    Encoder(uint8_t pin_a, PIO pio = pio1);
+    
+    /**
+     * @brief Load the PIO program and start decoding
+     * @param max_step_rate Highest expected step rate in steps/s (0 = full speed)
+     * @return true on success, false if PIO resources are taken
+     */
+    bool init(uint32_t max_step_rate = 0);
+    
+    /**
+     * @brief Get the current count
+     * @return Counts since init() or the last reset()
+     */
+    int32_t getCount();
+    
+    /**
+     * @brief Set the current position as a new zero
+     * @param count Value the current position should read as
+     */
+    void reset(int32_t count = 0);
+    
+private:
+    uint8_t pin_a_;
+    PIO pio_;
+    uint sm_;
+    int32_t offset_;
+    bool initialized_;
+    
+    /**
+     * @brief Read the raw count from the state machine
+     * @return Raw PIO count
+     */
+    int32_t readRaw();
+};
+
+#endif // ENCODER_H
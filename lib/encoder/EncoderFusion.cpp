@@ -0,0 +1,47 @@
+/**
+ * @file EncoderFusion.cpp
+ * @brief Implementation of encoder / absolute position fusion
+ */
+
+#include "EncoderFusion.h"
+
+EncoderFusion::EncoderFusion(float cm_per_count, float gain)
+    : cm_per_count_(cm_per_count), gain_(gain), offset_cm_(0.0f), velocity_cm_s_(0.0f),
+      count_(0), last_count_(0), last_time_us_(0), has_time_(false), locked_(false) {
+}
+
+void EncoderFusion::reset(float position_cm, int32_t count) {
+    count_ = count;
+    last_count_ = count;
+    offset_cm_ = position_cm - count * cm_per_count_;
+    velocity_cm_s_ = 0.0f;
+    has_time_ = false;
+    locked_ = true;
+}
+
+void EncoderFusion::update(int32_t count, uint32_t timestamp_us) {
+    count_ = count;
+    
+    if (has_time_) {
+        uint32_t dt_us = timestamp_us - last_time_us_;
+        if (dt_us == 0) {
+            return;
+        }
+        float velocity = (count - last_count_) * cm_per_count_ * 1000000.0f / dt_us;
+        velocity_cm_s_ += VELOCITY_SMOOTHING * (velocity - velocity_cm_s_);
+    }
+    
+    last_count_ = count;
+    last_time_us_ = timestamp_us;
+    has_time_ = true;
+}
+
+void EncoderFusion::correct(float position_cm) {
+    if (!locked_) {
+        offset_cm_ = position_cm - count_ * cm_per_count_;
+        locked_ = true;
+        return;
+    }
+    
+    offset_cm_ += gain_ * (position_cm - getPosition());
+}
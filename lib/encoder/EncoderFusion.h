@@ -0,0 +1,79 @@
+/**
+ * @file EncoderFusion.h
+ * @brief Complementary fusion of encoder counts with absolute position fixes
+ * 
+ * The encoder gives fast, smooth relative motion but drifts (belt slip,
+ * missed steps); the ultrasonic sensor gives a slow, noisy absolute
+ * position. The fused position follows the encoder at the control rate
+ * and each absolute fix pulls the encoder's zero offset a fraction of
+ * the way toward agreement:
+ * 
+ *   position = offset + count * cm_per_count
+ *   offset  += gain * (fix - position)       (on every absolute fix)
+ * 
+ * Velocity comes from count differences, low-pass filtered.
+ */
+
+#ifndef ENCODERFUSION_H
+#define ENCODERFUSION_H
+
+#include <cstdint>
+
+class EncoderFusion {
+public:
+    /**
+     * @brief Constructor for encoder fusion
+     * @param cm_per_count Travel per encoder count (negative to reverse)
+     * @param gain Fraction of each absolute fix error corrected (0.0 - 1.0)
+     */
+    EncoderFusion(float cm_per_count, float gain);
+    
+    /**
+     * @brief Anchor the fused position
+     * @param position_cm Known position in cm
+     * @param count Encoder count at that position
+     */
+    void reset(float position_cm, int32_t count);
+    
+    /**
+     * @brief Forget the anchor (the next absolute fix snaps the position)
+     */
+    void unlock() { locked_ = false; }
+    
+    /**
+     * @brief Advance with a new encoder count (high rate)
+     * @param count Encoder count
+     * @param timestamp_us Time of the count in microseconds
+     */
+    void update(int32_t count, uint32_t timestamp_us);
+    
+    /**
+     * @brief Apply an absolute position fix (low rate)
+     * @param position_cm Absolute position in cm
+     */
+    void correct(float position_cm);
+    
+    /**
+     * @brief Check if the position is anchored
+     * @return true after reset() or the first correct()
+     */
+    bool isLocked() const { return locked_; }
+    
+    float getPosition() const { return offset_cm_ + count_ * cm_per_count_; }
+    float getVelocity() const { return velocity_cm_s_; }
+    
+private:
+    float cm_per_count_;
+    float gain_;
+    float offset_cm_;
+    float velocity_cm_s_;
+    int32_t count_;
+    int32_t last_count_;
+    uint32_t last_time_us_;
+    bool has_time_;
+    bool locked_;
+    
+    static constexpr float VELOCITY_SMOOTHING = 0.3f;  // Low-pass weight of new velocity
+};
+
+#endif // ENCODERFUSION_H
@@ -0,0 +1,53 @@
+/**
+ * @file GpioIrq.cpp
+ * @brief Implementation of shared GPIO edge interrupt dispatch
+ */
+
+#include "GpioIrq.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+GpioIrq::Listener GpioIrq::listeners_[NUM_BANK0_GPIOS] = {};
+uint32_t GpioIrq::pin_mask_ = 0;
+bool GpioIrq::irq_handler_installed_ = false;
+
+void GpioIrq::attach(uint pin, uint32_t events, Callback callback, void* user_data) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    listeners_[pin].callback = callback;
+    listeners_[pin].user_data = user_data;
+    listeners_[pin].events = events;
+    pin_mask_ |= (1u << pin);
+    restore_interrupts(irq_state);
+    
+    if (!irq_handler_installed_) {
+        irq_add_shared_handler(IO_IRQ_BANK0, gpioIrqHandler,
+                               PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+        irq_handler_installed_ = true;
+    }
+}
+
+void GpioIrq::detach(uint pin) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    gpio_set_irq_enabled(pin, listeners_[pin].events, false);
+    pin_mask_ &= ~(1u << pin);
+    listeners_[pin].callback = nullptr;
+    restore_interrupts(irq_state);
+}
+
+void GpioIrq::gpioIrqHandler() {
+    uint32_t timestamp_us = time_us_32();
+    uint32_t pending = pin_mask_;
+    
+    while (pending) {
+        uint pin = __builtin_ctz(pending);
+        pending &= pending - 1;
+        
+        // Only the edges this pin registered; others belong to other handlers
+        uint32_t events = gpio_get_irq_event_mask(pin) & listeners_[pin].events;
+        if (events) {
+            gpio_acknowledge_irq(pin, events);
+            listeners_[pin].callback(listeners_[pin].user_data, events, timestamp_us);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file GpioIrq.h
+ * @brief Shared GPIO edge interrupt dispatch
+ * 
+ * All bank 0 GPIOs share one interrupt (IO_IRQ_BANK0). The ultrasonic
+ * echo, the limit switch and the push buttons each need edge interrupts
+ * on their own pins; this dispatcher owns the single handler so the
+ * drivers do not each install one and walk their own pin tables.
+ * 
+ * Drivers register a callback per pin together with the edges they
+ * handle, then enable those edges with gpio_set_irq_enabled() whenever
+ * they need them. The handler reads the time once, acknowledges each
+ * registered pin's pending edges and passes them to its callback.
+ * 
+ * Callbacks run in interrupt context and must be short.
+ */
+
+#ifndef GPIOIRQ_H
+#define GPIOIRQ_H
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include <cstdint>
+
+class GpioIrq {
+public:
+    /**
+     * @param user_data Value given to attach()
+     * @param events Pending GPIO_IRQ_EDGE_* bits (already acknowledged)
+     * @param timestamp_us time_us_32() at interrupt entry
+     */
+    typedef void (*Callback)(void* user_data, uint32_t events, uint32_t timestamp_us);
+    
+    /**
+     * @brief Register an edge callback for one pin (edges stay disabled)
+     * @param pin GPIO number
+     * @param events GPIO_IRQ_EDGE_* bits the callback handles
+     * @param callback Function called for each pending edge set
+     * @param user_data Passed to callback
+     */
+    static void attach(uint pin, uint32_t events, Callback callback, void* user_data);
+    
+    /**
+     * @brief Disable the pin's edges and drop its callback (IRQ-safe)
+     * @param pin GPIO number
+     */
+    static void detach(uint pin);
+    
+private:
+    struct Listener {
+        Callback callback;
+        void* user_data;
+        uint32_t events;
+    };
+    
+    static Listener listeners_[NUM_BANK0_GPIOS];
+    static uint32_t pin_mask_;
+    static bool irq_handler_installed_;
+    
+    /**
+     * @brief Shared IO_IRQ_BANK0 handler
+     */
+    static void gpioIrqHandler();
+};
+
+#endif // GPIOIRQ_H
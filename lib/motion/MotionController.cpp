@@ -0,0 +1,401 @@
+/**
+ * @file MotionController.cpp
+ * @brief Implementation of non-blocking carriage motion state machine
+ */
+
+#include "MotionController.h"
+
+MotionController::MotionController(Ultrasonic& sensor, DistanceFilter<3>& filter,
+                                   PositionController& controller, MotionPlanner& planner)
+    : sensor_(sensor), filter_(filter), controller_(controller), planner_(planner),
+      encoder_(nullptr), fusion_(nullptr), observer_(nullptr), control_period_us_(1000),
+      max_blind_pings_(UINT8_MAX), blind_pings_(0), confirming_(false), confirm_start_ms_(0),
+      stop_count_(0),
+      timeout_ms_(10000), ping_interval_ms_(20), window_margin_cm_(3.0f),
+      overshoot_margin_cm_(10.0f), min_confidence_(0.6f),
+      state_(IDLE), target_stop_(0), position_cm_(0.0f), profile_(nullptr),
+      window_min_cm_(0.0f), window_max_cm_(0.0f),
+      start_time_ms_(0), profile_start_us_(0), last_ping_ms_(0), last_control_us_(0),
+      motor_events_(0),
+      limit_switch_(nullptr), switch_position_cm_(0.0f),
+      homing_fast_speed_(0), homing_slow_speed_(0), homing_backoff_us_(0),
+      homing_stage_(HOMING_NONE), homing_stage_us_(0) {
+}
+
+void MotionController::setStops(const float* positions, uint8_t count) {
+    if (count > MAX_STOPS) {
+        count = MAX_STOPS;
+    }
+    
+    stop_count_ = count;
+    for (uint8_t i = 0; i < count; i++) {
+        stops_[i] = positions[i];
+    }
+    
+    planner_.precompute(stops_, stop_count_);
+    position_cm_ = stops_[0];
+}
+
+void MotionController::configure(uint32_t timeout_ms, uint32_t ping_interval_ms,
+                                 float window_margin_cm, float overshoot_margin_cm,
+                                 float min_confidence) {
+    timeout_ms_ = timeout_ms;
+    ping_interval_ms_ = ping_interval_ms;
+    window_margin_cm_ = window_margin_cm;
+    overshoot_margin_cm_ = overshoot_margin_cm;
+    min_confidence_ = min_confidence;
+}
+
+void MotionController::setEncoder(Encoder* encoder, EncoderFusion* fusion,
+                                  uint32_t control_period_us) {
+    encoder_ = (fusion != nullptr) ? encoder : nullptr;
+    fusion_ = fusion;
+    control_period_us_ = control_period_us;
+}
+
+void MotionController::setObserver(PositionObserver* observer, uint32_t control_period_us,
+                                   uint8_t max_blind_pings) {
+    observer_ = observer;
+    max_blind_pings_ = max_blind_pings;
+    if (encoder_ == nullptr) {
+        control_period_us_ = control_period_us;
+    }
+}
+
+void MotionController::setLimitSwitch(LimitSwitch* limit_switch, float position_cm,
+                                      uint8_t fast_speed, uint8_t slow_speed,
+                                      uint32_t backoff_ms) {
+    limit_switch_ = limit_switch;
+    switch_position_cm_ = position_cm;
+    homing_fast_speed_ = fast_speed;
+    homing_slow_speed_ = slow_speed;
+    homing_backoff_us_ = backoff_ms * 1000;
+    
+    if (limit_switch_ != nullptr) {
+        limit_switch_->setCallback(onLimitSwitch, this);
+    }
+}
+
+int32_t MotionController::getPredictedArrivalUs() const {
+    if (observer_ == nullptr || state_ != MOVING || !observer_->isLocked()) {
+        return -1;
+    }
+    return observer_->predictCrossingTime(controller_.getTarget());
+}
+
+bool MotionController::requestMove(uint8_t stop) {
+    if (state_ == MOVING || stop >= stop_count_) {
+        return false;
+    }
+    
+    startMove(stop);
+    return true;
+}
+
+void MotionController::startMove(uint8_t stop) {
+    float target_cm = stops_[stop];
+    target_stop_ = stop;
+    
+    // Only accept echoes between where we are and where we are going,
+    // plus room to see (and correct) an overshoot past the target
+    if (target_cm >= position_cm_) {
+        window_min_cm_ = position_cm_ - window_margin_cm_;
+        window_max_cm_ = target_cm + window_margin_cm_ + overshoot_margin_cm_;
+    } else {
+        window_min_cm_ = target_cm - window_margin_cm_ - overshoot_margin_cm_;
+        window_max_cm_ = position_cm_ + window_margin_cm_;
+    }
+    if (window_min_cm_ < 0.0f) {
+        window_min_cm_ = 0.0f;
+    }
+    
+    // Start tracking from the last settled position
+    filter_.reset(position_cm_);
+    if (encoder_ != nullptr) {
+        fusion_->reset(position_cm_, encoder_->getCount());
+    } else if (observer_ != nullptr) {
+        observer_->reset(position_cm_, time_us_32());
+    }
+    
+    // Follow a jerk-limited profile (precomputed for stop-to-stop moves)
+    profile_ = &planner_.plan(position_cm_, target_cm, controller_.getTolerance());
+    
+    begin(target_cm);
+}
+
+bool MotionController::requestHome() {
+    if (state_ == MOVING || stop_count_ == 0) {
+        return false;
+    }
+    
+    target_stop_ = 0;
+    
+    if (limit_switch_ != nullptr) {
+        start_time_ms_ = to_ms_since_boot(get_absolute_time());
+        motor_events_ = 0;
+        state_ = MOVING;
+        
+        // Already on the switch: skip straight to backing off
+        enterHomingStage(limit_switch_->isPressed() ? HOMING_BACKOFF : HOMING_FAST, time_us_32());
+        return true;
+    }
+    
+    // Position unknown: accept the full range and let the filter lock on fresh
+    window_min_cm_ = 0.0f;
+    window_max_cm_ = 0.0f;
+    filter_.reset();
+    if (encoder_ != nullptr) {
+        fusion_->unlock();
+    } else if (observer_ != nullptr) {
+        observer_->unlock();
+    }
+    profile_ = nullptr;
+    
+    begin(stops_[0]);
+    return true;
+}
+
+void MotionController::begin(float target_cm) {
+    controller_.setTarget(target_cm);
+    
+    start_time_ms_ = to_ms_since_boot(get_absolute_time());
+    profile_start_us_ = time_us_32();
+    last_ping_ms_ = start_time_ms_ - ping_interval_ms_;
+    last_control_us_ = profile_start_us_ - control_period_us_;
+    motor_events_ = 0;
+    blind_pings_ = 0;
+    confirming_ = false;
+    state_ = MOVING;
+    
+    // Observer positions are predictions: learn stop runout from the sensor
+    controller_.setDeferredStopLearning(usingObserver());
+}
+
+MotionController::State MotionController::update() {
+    if (state_ != MOVING) {
+        return state_;
+    }
+    
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    
+    // Check timeout
+    if ((now - start_time_ms_) > timeout_ms_) {
+        cancel();
+        return state_;
+    }
+    
+    // Jammed or overloaded: the driver has already cut the motor
+    uint8_t events = controller_.getMotor().updateCurrent();
+    if (events != 0) {
+        cancel();
+        motor_events_ = events;
+        return state_;
+    }
+    
+    if (homing_stage_ != HOMING_NONE) {
+        updateHoming(time_us_32());
+        return state_;
+    }
+    
+    // Trigger next ping; the echo is captured by interrupt
+    if (!sensor_.isBusy() && (now - last_ping_ms_) >= ping_interval_ms_) {
+        if (window_max_cm_ > window_min_cm_) {
+            sensor_.startMeasurement(window_min_cm_, window_max_cm_);
+        } else {
+            sensor_.startMeasurement();
+        }
+        last_ping_ms_ = now;
+        
+        // Dead reckoning alone drifts: stop driving until the sensor agrees again
+        if (usingObserver() && blind_pings_ < UINT8_MAX && ++blind_pings_ == max_blind_pings_ + 1) {
+            controller_.hold();
+        }
+    }
+    
+    uint32_t timestamp_us = time_us_32();
+    
+    if (sensor_.poll()) {
+        const DistanceEstimate& estimate = filter_.update(sensor_.getLastDistance(), timestamp_us);
+        bool trusted = estimate.valid && estimate.confidence >= min_confidence_;
+        
+        if (encoder_ != nullptr) {
+            // Sensor only corrects encoder drift
+            if (trusted) {
+                fusion_->correct(estimate.position_cm);
+            }
+        } else if (observer_ != nullptr) {
+            // Sensor corrects (and teaches) the dead-reckoning model
+            if (trusted) {
+                observer_->correct(estimate.position_cm, estimate.velocity_cm_s, timestamp_us);
+                blind_pings_ = 0;
+                
+                // Only a ping sent after the observer settled can confirm arrival
+                if (confirming_ && (int32_t)(last_ping_ms_ - confirm_start_ms_) > 0) {
+                    confirmArrival(estimate.position_cm);
+                }
+            }
+        } else if (trusted) {
+            // Run one control step per measurement
+            controlStep(estimate.position_cm, estimate.velocity_cm_s, timestamp_us);
+        } else if (controller_.getOutput() != 0.0f) {
+            // Lost track while moving: hold still until the filter locks again
+            controller_.hold();
+        }
+    }
+    
+    // With an encoder or observer, control at the fixed control rate
+    bool high_rate = encoder_ != nullptr || observer_ != nullptr;
+    if (high_rate && state_ == MOVING && (timestamp_us - last_control_us_) >= control_period_us_) {
+        last_control_us_ = timestamp_us;
+        
+        if (encoder_ != nullptr) {
+            fusion_->update(encoder_->getCount(), timestamp_us);
+            if (fusion_->isLocked()) {
+                controlStep(fusion_->getPosition(), fusion_->getVelocity(), timestamp_us);
+            }
+        } else {
+            observer_->predict(timestamp_us);
+            if (observer_->isLocked() && !confirming_ && blind_pings_ <= max_blind_pings_) {
+                controlStep(observer_->getPosition(), observer_->getVelocity(), timestamp_us);
+            }
+        }
+    }
+    
+    return state_;
+}
+
+void MotionController::controlStep(float position_cm, float velocity_cm_s,
+                                   uint32_t timestamp_us) {
+    if (profile_ != nullptr) {
+        MotionSample reference = profile_->sample(timestamp_us - profile_start_us_);
+        controller_.track(reference.position_cm, reference.velocity_cm_s);
+    }
+    
+    position_cm_ = position_cm;
+    if (controller_.update(position_cm, velocity_cm_s, timestamp_us) == PositionController::SETTLED) {
+        if (usingObserver()) {
+            // The observer only predicts; wait for the sensor to confirm
+            confirming_ = true;
+            confirm_start_ms_ = to_ms_since_boot(get_absolute_time());
+        } else {
+            state_ = ARRIVED;
+        }
+    }
+}
+
+void MotionController::confirmArrival(float position_cm) {
+    confirming_ = false;
+    position_cm_ = position_cm;
+    controller_.learnRunout(position_cm);
+    
+    float error = position_cm - controller_.getTarget();
+    if (error <= controller_.getTolerance() && error >= -controller_.getTolerance()) {
+        state_ = ARRIVED;
+        return;
+    }
+    
+    // Missed: the observer has just been corrected, finish with plain PID
+    profile_ = nullptr;
+    controller_.setTarget(controller_.getTarget());
+}
+
+void MotionController::cancel() {
+    if (state_ != MOVING) {
+        return;
+    }
+    
+    if (homing_stage_ != HOMING_NONE) {
+        limit_switch_->disarm();
+        homing_stage_ = HOMING_NONE;
+    }
+    
+    controller_.stop();
+    state_ = FAILED;
+}
+
+void MotionController::updateHoming(uint32_t now_us) {
+    switch (homing_stage_) {
+        case HOMING_FAST:
+            if (limit_switch_->isTriggered()) {
+                enterHomingStage(HOMING_BACKOFF, now_us);
+            }
+            break;
+            
+        case HOMING_BACKOFF:
+            // Back-off time counts from the last moment the switch was closed
+            if (limit_switch_->isPressed()) {
+                homing_stage_us_ = now_us;
+            } else if ((now_us - homing_stage_us_) >= homing_backoff_us_) {
+                enterHomingStage(HOMING_SLOW, now_us);
+            }
+            break;
+            
+        case HOMING_SLOW:
+            if (limit_switch_->isTriggered()) {
+                enterHomingStage(HOMING_SETTLE, limit_switch_->getTriggerTimeUs());
+            }
+            break;
+            
+        case HOMING_SETTLE:
+            if ((now_us - homing_stage_us_) < HOMING_SETTLE_US) {
+                break;
+            }
+            
+            // Re-zero on the switch edge (the next move re-anchors the
+            // filter, encoder fusion and observer here)
+            homing_stage_ = HOMING_NONE;
+            position_cm_ = switch_position_cm_;
+            
+            if (stop_count_ > 0) {
+                float offset = stops_[0] - position_cm_;
+                if (offset > controller_.getTolerance() || offset < -controller_.getTolerance()) {
+                    startMove(0);  // Home stop is away from the switch
+                    break;
+                }
+            }
+            state_ = ARRIVED;
+            break;
+            
+        case HOMING_NONE:
+            break;
+    }
+}
+
+void MotionController::enterHomingStage(HomingStage stage, uint32_t now_us) {
+    homing_stage_ = stage;
+    homing_stage_us_ = now_us;
+    
+    // Home is toward decreasing distance (REVERSE)
+    switch (stage) {
+        case HOMING_FAST:
+            limit_switch_->arm();
+            controller_.driveOpenLoop(-(float)homing_fast_speed_);
+            if (limit_switch_->isTriggered()) {
+                controller_.brakeNow();  // Closed before the drive started
+            }
+            break;
+            
+        case HOMING_BACKOFF:
+            limit_switch_->disarm();
+            controller_.driveOpenLoop(homing_slow_speed_);
+            break;
+            
+        case HOMING_SLOW:
+            limit_switch_->arm();
+            controller_.driveOpenLoop(-(float)homing_slow_speed_);
+            if (limit_switch_->isTriggered()) {
+                controller_.brakeNow();
+            }
+            break;
+            
+        case HOMING_SETTLE:
+        case HOMING_NONE:
+            controller_.driveOpenLoop(0.0f);
+            break;
+    }
+}
+
+void MotionController::onLimitSwitch(void* user_data) {
+    // Brake on the edge itself; update() only sees the latch a loop later
+    static_cast<MotionController*>(user_data)->controller_.brakeNow();
+}
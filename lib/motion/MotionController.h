@@ -0,0 +1,297 @@
+/**
+ * @file MotionController.h
+ * @brief Non-blocking carriage motion state machine
+ * 
+ * Runs a whole move (ultrasonic pinging, filtering, profile tracking and
+ * PID control) one step per update() call, so the caller's main loop
+ * keeps servicing buttons, servos and the buzzer during travel.
+ * 
+ * Usage:
+ *   motion.requestMove(2);
+ *   while (motion.update() == MotionController::MOVING) { ...other work... }
+ *   if (motion.state() == MotionController::ARRIVED) { ... }
+ * 
+ * With an encoder attached (setEncoder), the control loop runs from the
+ * fused encoder position at the control period (kHz) and the ultrasonic
+ * readings only correct drift. Without one, a PositionObserver
+ * (setObserver) predicts the position between pings from the motor
+ * command, so the loop still runs at the control period and stops at the
+ * predicted crossing instead of the next ping. The prediction is never
+ * trusted alone: the carriage holds still if too many pings pass without
+ * a trusted reading, and a move only ARRIVES once a reading taken at rest
+ * confirms the target (that reading also teaches the stop model). With
+ * neither, control runs once per ping.
+ * 
+ * Stops are indexed with 0 = home, 1..N = columns. Moves between known
+ * stops follow precomputed MotionPlanner profiles; homing (used after a
+ * failed move, when the position is unknown) uses plain PID.
+ * 
+ * With a limit switch (setLimitSwitch), homing runs open loop instead:
+ * 1. Fast approach until the switch closes (the switch IRQ brakes the motor)
+ * 2. Slow back-off until the switch has been open for the back-off time
+ * 3. Slow re-approach; the switch IRQ brakes on first contact
+ * The position is then re-zeroed to the switch position and the
+ * carriage moves on to stop 0 if the two differ.
+ * 
+ * Every update() also checks the motor current (if the motor has current
+ * sense): a stall or overload fails the move at once instead of after
+ * the timeout. getMotorEvents() tells which.
+ */
+
+#ifndef MOTIONCONTROLLER_H
+#define MOTIONCONTROLLER_H
+
+#include "pico/stdlib.h"
+#include "Ultrasonic.h"
+#include "DistanceFilter.h"
+#include "PositionController.h"
+#include "MotionPlanner.h"
+#include "Encoder.h"
+#include "EncoderFusion.h"
+#include "PositionObserver.h"
+#include "LimitSwitch.h"
+#include <cstdint>
+
+class MotionController {
+public:
+    enum State {
+        IDLE,     // No move requested
+        MOVING,   // Travelling to the requested stop
+        ARRIVED,  // Settled at the requested stop
+        FAILED    // Timed out or cancelled (motor stopped)
+    };
+    
+    /**
+     * @brief Constructor for motion controller
+     * @param sensor Position sensor
+     * @param filter Distance filter for the sensor readings
+     * @param controller Position controller driving the motor
+     * @param planner Motion planner for stop-to-stop profiles
+     */
+    MotionController(Ultrasonic& sensor, DistanceFilter<3>& filter,
+                     PositionController& controller, MotionPlanner& planner);
+    
+    /**
+     * @brief Set stop positions and precompute profiles between them
+     * The carriage is assumed to start at stop 0 (home).
+     * @param positions Stop positions in cm (index 0 = home)
+     * @param count Number of stops
+     */
+    void setStops(const float* positions, uint8_t count);
+    
+    /**
+     * @brief Set tuning parameters
+     * @param timeout_ms Give up on a move after this long
+     * @param ping_interval_ms Minimum time between ultrasonic pings
+     * @param window_margin_cm Echo gate slack around the travel range
+     * @param overshoot_margin_cm Extra gate slack past the target, so an
+     *        overshoot is still measured and corrected
+     * @param min_confidence Minimum filter confidence to run the controller
+     */
+    void configure(uint32_t timeout_ms, uint32_t ping_interval_ms,
+                   float window_margin_cm, float overshoot_margin_cm, float min_confidence);
+    
+    /**
+     * @brief Run the control loop from an encoder fused with the sensor
+     * @param encoder Initialized encoder (nullptr = sensor only)
+     * @param fusion Fusion filter for encoder counts and sensor fixes
+     * @param control_period_us Control step period in microseconds
+     */
+    void setEncoder(Encoder* encoder, EncoderFusion* fusion, uint32_t control_period_us);
+    
+    /**
+     * @brief Run the control loop from a dead-reckoning observer
+     * Ignored while an encoder is attached.
+     * @param observer Observer corrected by the sensor (nullptr = sensor only)
+     * @param control_period_us Control step period in microseconds
+     * @param max_blind_pings Hold still after this many pings without a trusted reading
+     */
+    void setObserver(PositionObserver* observer, uint32_t control_period_us,
+                     uint8_t max_blind_pings);
+    
+    /**
+     * @brief Home against a limit switch instead of the sensor
+     * @param limit_switch Initialized switch (nullptr = sensor homing)
+     * @param position_cm Carriage position when the switch closes
+     * @param fast_speed Speed of the first approach (0-100)
+     * @param slow_speed Speed of the back-off and re-approach (0-100)
+     * @param backoff_ms Time to keep backing off once the switch opens
+     */
+    void setLimitSwitch(LimitSwitch* limit_switch, float position_cm,
+                        uint8_t fast_speed, uint8_t slow_speed, uint32_t backoff_ms);
+    
+    /**
+     * @brief Predict time until the carriage reaches the target
+     * @return Microseconds until arrival, or -1 if unknown (no observer
+     *         or not approaching)
+     */
+    int32_t getPredictedArrivalUs() const;
+    
+    /**
+     * @brief Start a move to a stop
+     * @param stop Stop index (0 = home, 1..N = columns)
+     * @return true if accepted (not already moving, valid stop)
+     */
+    bool requestMove(uint8_t stop);
+    
+    /**
+     * @brief Start homing from an unknown position
+     * @return true if accepted (not already moving)
+     */
+    bool requestHome();
+    
+    /**
+     * @brief Advance the move by one step (call every main loop tick)
+     * @return State after this step
+     */
+    State update();
+    
+    /**
+     * @brief Get current state
+     * @return State
+     */
+    State state() const { return state_; }
+    
+    /**
+     * @brief Abort a move in progress (state becomes FAILED)
+     */
+    void cancel();
+    
+    /**
+     * @brief Check if a move is in progress
+     * @return true while MOVING
+     */
+    bool isActive() const { return state_ == MOVING; }
+    
+    /**
+     * @brief Get last trusted position
+     * @return Position in cm
+     */
+    float getPosition() const { return position_cm_; }
+    
+    /**
+     * @brief Get current-sense events that failed the last move
+     * @return MotorDriver::CurrentEvent bits (0 = none, e.g. timeout or cancel)
+     */
+    uint8_t getMotorEvents() const { return motor_events_; }
+    
+    /**
+     * @brief Get stop index of the current or last move
+     * @return Stop index
+     */
+    uint8_t getTargetStop() const { return target_stop_; }
+    
+    /**
+     * @brief Get latest filter estimate (telemetry)
+     * @return Estimate
+     */
+    const DistanceEstimate& getEstimate() const { return filter_.getEstimate(); }
+    
+    static constexpr uint8_t MAX_STOPS = MotionPlanner::MAX_STOPS;
+    
+private:
+    enum HomingStage {
+        HOMING_NONE,      // Not homing against the switch
+        HOMING_FAST,      // Fast approach
+        HOMING_BACKOFF,   // Backing off the switch
+        HOMING_SLOW,      // Slow re-approach
+        HOMING_SETTLE     // Braked on the switch, waiting to come to rest
+    };
+    
+    Ultrasonic& sensor_;
+    DistanceFilter<3>& filter_;
+    PositionController& controller_;
+    MotionPlanner& planner_;
+    Encoder* encoder_;
+    EncoderFusion* fusion_;
+    PositionObserver* observer_;
+    uint32_t control_period_us_;
+    uint8_t max_blind_pings_;
+    uint8_t blind_pings_;          // Pings since the last trusted reading (observer mode)
+    bool confirming_;              // Observer says settled, waiting for a reading at rest
+    uint32_t confirm_start_ms_;
+    
+    float stops_[MAX_STOPS];
+    uint8_t stop_count_;
+    
+    uint32_t timeout_ms_;
+    uint32_t ping_interval_ms_;
+    float window_margin_cm_;
+    float overshoot_margin_cm_;
+    float min_confidence_;
+    
+    State state_;
+    uint8_t target_stop_;
+    float position_cm_;
+    const MotionProfile* profile_;
+    float window_min_cm_;
+    float window_max_cm_;
+    uint32_t start_time_ms_;
+    uint32_t profile_start_us_;
+    uint32_t last_ping_ms_;
+    uint32_t last_control_us_;
+    uint8_t motor_events_;
+    
+    LimitSwitch* limit_switch_;
+    float switch_position_cm_;
+    uint8_t homing_fast_speed_;
+    uint8_t homing_slow_speed_;
+    uint32_t homing_backoff_us_;
+    HomingStage homing_stage_;
+    uint32_t homing_stage_us_;
+    
+    static constexpr uint32_t HOMING_SETTLE_US = 100000;
+    
+    /**
+     * @brief Common move start
+     * @param target_cm Target position
+     */
+    void begin(float target_cm);
+    
+    /**
+     * @brief Start a profiled move from the current position
+     * @param stop Stop index
+     */
+    void startMove(uint8_t stop);
+    
+    /**
+     * @brief Advance limit-switch homing by one step
+     * @param now_us Current time in microseconds
+     */
+    void updateHoming(uint32_t now_us);
+    
+    /**
+     * @brief Enter a homing stage and drive the motor for it
+     * @param stage New stage
+     * @param now_us Current time in microseconds
+     */
+    void enterHomingStage(HomingStage stage, uint32_t now_us);
+    
+    /**
+     * @brief Limit switch trigger callback (called from IRQ)
+     * @param user_data MotionController instance
+     */
+    static void onLimitSwitch(void* user_data);
+    
+    /**
+     * @brief Check if control runs from the dead-reckoning observer
+     * @return true with an observer and no encoder
+     */
+    bool usingObserver() const { return encoder_ == nullptr && observer_ != nullptr; }
+    
+    /**
+     * @brief Accept or reject an observer arrival with a reading taken at rest
+     * @param position_cm Trusted sensor position
+     */
+    void confirmArrival(float position_cm);
+    
+    /**
+     * @brief Run one control step
+     * @param position_cm Measured position
+     * @param velocity_cm_s Measured velocity
+     * @param timestamp_us Measurement time
+     */
+    void controlStep(float position_cm, float velocity_cm_s, uint32_t timestamp_us);
+};
+
+#endif // MOTIONCONTROLLER_H
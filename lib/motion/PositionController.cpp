@@ -0,0 +1,264 @@
+/**
+ * @file PositionController.cpp
+ * @brief Implementation of closed-loop PID position controller
+ */
+
+#include "PositionController.h"
+
+PositionController::PositionController(MotorDriver& motor, float kp, float ki, float kd,
+                                       float kff)
+    : motor_(motor), kp_(kp), ki_(ki), kd_(kd), kff_(kff), ff_offset_(0),
+      min_speed_(0), max_speed_(100), slowdown_cm_(0.0f),
+      tolerance_cm_(0.5f), settle_velocity_cm_s_(1.0f), settle_hold_us_(100000),
+      stop_model_(nullptr), stop_position_cm_(0.0f), stop_velocity_cm_s_(0.0f), stopping_(false),
+      defer_stop_learning_(false), runout_pending_(false),
+      target_cm_(0.0f), reference_velocity_(0.0f), error_cm_(0.0f), integral_(0.0f), output_(0.0f),
+      last_time_us_(0), settle_start_us_(0),
+      has_time_(false), settling_(false), status_(IDLE) {
+}
+
+void PositionController::setSpeedLimits(uint8_t min_speed, uint8_t max_speed) {
+    if (max_speed > 100) {
+        max_speed = 100;
+    }
+    if (min_speed > max_speed) {
+        min_speed = max_speed;
+    }
+    
+    min_speed_ = min_speed;
+    max_speed_ = max_speed;
+}
+
+void PositionController::setSlowdownDistance(float distance_cm) {
+    slowdown_cm_ = distance_cm;
+}
+
+void PositionController::setFeedforward(float kff, uint8_t offset) {
+    kff_ = kff;
+    ff_offset_ = offset;
+}
+
+void PositionController::setSettleCriteria(float tolerance_cm, float max_velocity_cm_s,
+                                           uint32_t hold_ms) {
+    tolerance_cm_ = tolerance_cm;
+    settle_velocity_cm_s_ = max_velocity_cm_s;
+    settle_hold_us_ = hold_ms * 1000;
+}
+
+void PositionController::setTarget(float target_cm) {
+    target_cm_ = target_cm;
+    reference_velocity_ = 0.0f;
+    integral_ = 0.0f;
+    output_ = 0.0f;
+    has_time_ = false;
+    settling_ = false;
+    stopping_ = false;
+    runout_pending_ = false;
+    status_ = MOVING;
+}
+
+void PositionController::track(float reference_cm, float reference_velocity_cm_s) {
+    target_cm_ = reference_cm;
+    reference_velocity_ = reference_velocity_cm_s;
+    if (status_ != MOVING) {
+        integral_ = 0.0f;
+        has_time_ = false;
+        stopping_ = false;
+        status_ = MOVING;
+    }
+}
+
+PositionController::Status PositionController::update(float position_cm, float velocity_cm_s,
+                                                      uint32_t timestamp_us) {
+    if (status_ != MOVING) {
+        return status_;
+    }
+    
+    error_cm_ = target_cm_ - position_cm;
+    float abs_error = error_cm_ < 0.0f ? -error_cm_ : error_cm_;
+    float abs_velocity = velocity_cm_s < 0.0f ? -velocity_cm_s : velocity_cm_s;
+    
+    float dt = 0.0f;
+    if (has_time_) {
+        dt = (timestamp_us - last_time_us_) / 1000000.0f;
+    }
+    last_time_us_ = timestamp_us;
+    has_time_ = true;
+    
+    bool tracking = reference_velocity_ != 0.0f;
+    
+    // Stopped early: let the carriage run out before judging the result
+    if (!tracking && handleStop(position_cm, velocity_cm_s, error_cm_, timestamp_us)) {
+        integral_ = 0.0f;
+        drive(0.0f);
+        return status_;
+    }
+    
+    // Settle criterion (only once the reference has stopped)
+    if (!tracking && abs_error <= tolerance_cm_ && abs_velocity <= settle_velocity_cm_s_) {
+        if (!settling_) {
+            settling_ = true;
+            settle_start_us_ = timestamp_us;
+        }
+        if ((timestamp_us - settle_start_us_) >= settle_hold_us_) {
+            drive(0.0f);
+            status_ = SETTLED;
+            return status_;
+        }
+    } else {
+        settling_ = false;
+    }
+    
+    // Inside the tolerance band: hold still, let the carriage settle
+    if (!tracking && abs_error <= tolerance_cm_) {
+        integral_ = 0.0f;
+        drive(0.0f);
+        return status_;
+    }
+    
+    // Speed limit shrinks with remaining distance (the profile does this when tracking)
+    float limit = max_speed_;
+    if (!tracking && slowdown_cm_ > 0.0f && abs_error < slowdown_cm_) {
+        limit = max_speed_ * (abs_error / slowdown_cm_);
+        if (limit < min_speed_) {
+            limit = min_speed_;
+        }
+    }
+    
+    float proportional = kp_ * error_cm_;
+    float derivative = kd_ * (reference_velocity_ - velocity_cm_s);
+    float feedforward = kff_ * reference_velocity_;
+    if (reference_velocity_ > 0.0f) {
+        feedforward += ff_offset_;
+    } else if (reference_velocity_ < 0.0f) {
+        feedforward -= ff_offset_;
+    }
+    float output = proportional + integral_ + derivative + feedforward;
+    
+    // Anti-windup: only integrate while not pushing further into saturation
+    bool saturated_high = output >= limit && error_cm_ > 0.0f;
+    bool saturated_low = output <= -limit && error_cm_ < 0.0f;
+    if (ki_ > 0.0f && !saturated_high && !saturated_low) {
+        integral_ += ki_ * error_cm_ * dt;
+        
+        float integral_max = max_speed_;
+        if (integral_ > integral_max) {
+            integral_ = integral_max;
+        } else if (integral_ < -integral_max) {
+            integral_ = -integral_max;
+        }
+        output = proportional + integral_ + derivative + feedforward;
+    }
+    
+    // Clamp to speed limit
+    if (output > limit) {
+        output = limit;
+    } else if (output < -limit) {
+        output = -limit;
+    }
+    
+    // Overcome stiction while still outside tolerance (same sign as error).
+    // Not while tracking: the profile's slow ends must not be sped up.
+    if (!tracking && error_cm_ > 0.0f && output < min_speed_ && output >= 0.0f) {
+        output = min_speed_;
+    } else if (!tracking && error_cm_ < 0.0f && output > -min_speed_ && output <= 0.0f) {
+        output = -(float)min_speed_;
+    }
+    
+    drive(output);
+    return status_;
+}
+
+void PositionController::stop() {
+    drive(0.0f);
+    settling_ = false;
+    stopping_ = false;
+    runout_pending_ = false;
+    status_ = IDLE;
+}
+
+void PositionController::driveOpenLoop(float output) {
+    settling_ = false;
+    stopping_ = false;
+    status_ = IDLE;
+    drive(output);
+}
+
+void PositionController::hold() {
+    drive(0.0f);
+    settling_ = false;
+    stopping_ = false;
+}
+
+bool PositionController::handleStop(float position_cm, float velocity_cm_s, float error_cm,
+                                    uint32_t timestamp_us) {
+    if (stop_model_ == nullptr) {
+        return false;
+    }
+    
+    float abs_error = error_cm < 0.0f ? -error_cm : error_cm;
+    float abs_velocity = velocity_cm_s < 0.0f ? -velocity_cm_s : velocity_cm_s;
+    
+    if (stopping_) {
+        // At rest once stationary for the settle hold time
+        if (abs_velocity > settle_velocity_cm_s_) {
+            settling_ = false;
+            return true;
+        }
+        if (!settling_) {
+            settling_ = true;
+            settle_start_us_ = timestamp_us;
+        }
+        if ((timestamp_us - settle_start_us_) < settle_hold_us_) {
+            return true;
+        }
+        
+        // Learn how far it went; the settle check then sees the hold as done
+        stopping_ = false;
+        runout_pending_ = true;
+        if (!defer_stop_learning_) {
+            learnRunout(position_cm);
+        }
+        return false;
+    }
+    
+    // Issue the stop once the carriage would run out onto the target
+    bool approaching = (error_cm > 0.0f && velocity_cm_s > 0.0f) ||
+                       (error_cm < 0.0f && velocity_cm_s < 0.0f);
+    if (approaching && abs_velocity > settle_velocity_cm_s_ &&
+        (abs_error <= tolerance_cm_ || abs_error <= stop_model_->predict(velocity_cm_s))) {
+        stop_position_cm_ = position_cm;
+        stop_velocity_cm_s_ = velocity_cm_s;
+        stopping_ = true;
+        settling_ = false;
+        return true;
+    }
+    
+    return false;
+}
+
+bool PositionController::learnRunout(float rest_position_cm) {
+    if (!runout_pending_ || stop_model_ == nullptr) {
+        return false;
+    }
+    
+    float travelled = rest_position_cm - stop_position_cm_;
+    if (stop_velocity_cm_s_ < 0.0f) {
+        travelled = -travelled;
+    }
+    stop_model_->learn(stop_velocity_cm_s_, travelled);
+    runout_pending_ = false;
+    return true;
+}
+
+void PositionController::drive(float output) {
+    output_ = output;
+    
+    if (output > 0.0f) {
+        motor_.run((uint8_t)(output + 0.5f), MotorDriver::FORWARD);
+    } else if (output < 0.0f) {
+        motor_.run((uint8_t)(-output + 0.5f), MotorDriver::REVERSE);
+    } else {
+        motor_.stop();
+    }
+}
@@ -0,0 +1,248 @@
+/**
+ * @file PositionController.h
+ * @brief Closed-loop PID position controller for the carriage
+ * 
+ * Drives a MotorDriver toward a target position using position and
+ * velocity measurements (e.g. from DistanceFilter). Call update() with
+ * every new measurement; the controller runs at the measurement rate.
+ * 
+ * Control Law:
+ * - P: proportional to position error
+ * - I: integral of error, with anti-windup (no integration while the
+ *   output is saturated in the direction of the error, and clamped)
+ * - D: on measured velocity (no derivative kick when the target changes)
+ * 
+ * Speed Limits:
+ * - Maximum speed scales down linearly inside the slowdown distance,
+ *   so the carriage approaches the target gently instead of coasting past
+ * - Minimum speed overcomes motor stiction outside the tolerance band
+ * 
+ * Trajectory Tracking:
+ * - track() moves the target along a planned profile (see MotionProfile)
+ *   and adds velocity feedforward; the PID only corrects tracking error
+ * 
+ * Position convention: positive output moves FORWARD (distance increasing).
+ * 
+ * Stop Compensation (setStopModel):
+ * - On the final approach the motor is stopped early, by the distance
+ *   the carriage is expected to travel after a stop command at the
+ *   current speed, so it comes to rest on the target instead of past it
+ * - The controller keeps the motor stopped until the carriage is at
+ *   rest, then feeds the distance actually travelled back to the model
+ * - If update() is fed a dead-reckoned position, the rest position is
+ *   only a guess: setDeferredStopLearning() leaves the learning to
+ *   learnRunout() with a real measurement taken at rest
+ * 
+ * Settle Criterion:
+ * - Error within tolerance and speed below a threshold for a hold time
+ */
+
+#ifndef POSITIONCONTROLLER_H
+#define POSITIONCONTROLLER_H
+
+#include "pico/stdlib.h"
+#include "MotorDriver.h"
+#include "StopDistanceModel.h"
+#include <cstdint>
+
+class PositionController {
+public:
+    enum Status {
+        IDLE,     // No target set
+        MOVING,   // Driving toward target
+        SETTLED   // Target reached and held (motor stopped)
+    };
+    
+    /**
+     * @brief Constructor for position controller
+     * @param motor Motor to drive
+     * @param kp Proportional gain (% speed per cm)
+     * @param ki Integral gain (% speed per cm*s)
+     * @param kd Derivative gain (% speed per cm/s)
+     * @param kff Velocity feedforward gain (% speed per cm/s), used by track()
+     */
+    PositionController(MotorDriver& motor, float kp, float ki, float kd, float kff = 0.0f);
+    
+    /**
+     * @brief Set speed limits
+     * @param min_speed Minimum speed that still moves the carriage (0-100)
+     * @param max_speed Maximum speed (0-100)
+     */
+    void setSpeedLimits(uint8_t min_speed, uint8_t max_speed);
+    
+    /**
+     * @brief Set distance over which the speed limit ramps down to the target
+     * @param distance_cm Slowdown distance in cm (0 disables scaling)
+     */
+    void setSlowdownDistance(float distance_cm);
+    
+    /**
+     * @brief Set velocity feedforward used by track()
+     * @param kff Feedforward gain (% speed per cm/s)
+     * @param offset Duty added in the direction of motion (motor deadband, %)
+     */
+    void setFeedforward(float kff, uint8_t offset);
+    
+    /**
+     * @brief Stop early by a learned stopping distance
+     * @param model Stop distance model (nullptr = stop inside tolerance only)
+     */
+    void setStopModel(StopDistanceModel* model) { stop_model_ = model; }
+    
+    /**
+     * @brief Learn stop runout from learnRunout() instead of at rest
+     * @param deferred true when update() positions are estimates, not measurements
+     */
+    void setDeferredStopLearning(bool deferred) { defer_stop_learning_ = deferred; }
+    
+    /**
+     * @brief Feed a measured rest position to the stop model (deferred mode)
+     * @param rest_position_cm Position measured after the carriage came to rest
+     * @return true if a stop was waiting to be learned
+     */
+    bool learnRunout(float rest_position_cm);
+    
+    /**
+     * @brief Set settle criterion
+     * @param tolerance_cm Allowed position error in cm
+     * @param max_velocity_cm_s Maximum speed considered stationary
+     * @param hold_ms Time both conditions must hold
+     */
+    void setSettleCriteria(float tolerance_cm, float max_velocity_cm_s, uint32_t hold_ms);
+    
+    /**
+     * @brief Start a move to a new target (motor starts on next update)
+     * @param target_cm Target position in cm
+     */
+    void setTarget(float target_cm);
+    
+    /**
+     * @brief Move the target along a trajectory (call before each update)
+     * Keeps the integral state; settling is only checked once the
+     * reference velocity is zero (end of the profile).
+     * @param reference_cm Reference position in cm
+     * @param reference_velocity_cm_s Reference velocity in cm/s
+     */
+    void track(float reference_cm, float reference_velocity_cm_s);
+    
+    /**
+     * @brief Run one control step with a new measurement
+     * @param position_cm Measured position in cm
+     * @param velocity_cm_s Measured velocity in cm/s
+     * @param timestamp_us Measurement time in microseconds
+     * @return Controller status after this step
+     */
+    Status update(float position_cm, float velocity_cm_s, uint32_t timestamp_us);
+    
+    /**
+     * @brief Abort the move and stop the motor
+     */
+    void stop();
+    
+    /**
+     * @brief Drive the motor without closed-loop control (ends any move)
+     * @param output Signed speed (-100 to 100, positive = FORWARD)
+     */
+    void driveOpenLoop(float output);
+    
+    /**
+     * @brief Brake the motor immediately, skipping the ramp (interrupt-safe)
+     */
+    void brakeNow() { motor_.brakeNow(); }
+    
+    /**
+     * @brief Stop the motor but keep the move active
+     * Used when measurements drop out; the next update() resumes control.
+     */
+    void hold();
+    
+    /**
+     * @brief Get controller status
+     * @return Current status
+     */
+    Status getStatus() const { return status_; }
+    
+    /**
+     * @brief Get target position
+     * @return Target in cm
+     */
+    float getTarget() const { return target_cm_; }
+    
+    /**
+     * @brief Get settle tolerance
+     * @return Allowed position error in cm
+     */
+    float getTolerance() const { return tolerance_cm_; }
+    
+    /**
+     * @brief Get position error of the last update
+     * @return Target minus measured position in cm
+     */
+    float getError() const { return error_cm_; }
+    
+    /**
+     * @brief Get the motor this controller drives
+     * @return Motor driver
+     */
+    MotorDriver& getMotor() { return motor_; }
+    
+    /**
+     * @brief Get output of the last update
+     * @return Signed speed command (-100 to 100, positive = FORWARD)
+     */
+    float getOutput() const { return output_; }
+    
+private:
+    MotorDriver& motor_;
+    
+    float kp_;
+    float ki_;
+    float kd_;
+    float kff_;
+    uint8_t ff_offset_;
+    
+    uint8_t min_speed_;
+    uint8_t max_speed_;
+    float slowdown_cm_;
+    
+    float tolerance_cm_;
+    float settle_velocity_cm_s_;
+    uint32_t settle_hold_us_;
+    
+    StopDistanceModel* stop_model_;
+    float stop_position_cm_;      // Where the last stop was commanded
+    float stop_velocity_cm_s_;    // Velocity when it was commanded
+    bool stopping_;               // Waiting for the carriage to come to rest
+    bool defer_stop_learning_;    // Rest position comes from learnRunout()
+    bool runout_pending_;         // Came to rest, waiting for learnRunout()
+    
+    float target_cm_;
+    float reference_velocity_;
+    float error_cm_;
+    float integral_;
+    float output_;
+    uint32_t last_time_us_;
+    uint32_t settle_start_us_;
+    bool has_time_;
+    bool settling_;
+    Status status_;
+    
+    /**
+     * @brief Apply a signed speed command to the motor
+     * @param output Signed speed (-100 to 100)
+     */
+    void drive(float output);
+    
+    /**
+     * @brief Track a stop command until the carriage is at rest
+     * @param position_cm Measured position in cm
+     * @param velocity_cm_s Measured velocity in cm/s
+     * @param error_cm Position error in cm
+     * @param timestamp_us Measurement time in microseconds
+     * @return true while the motor must stay stopped
+     */
+    bool handleStop(float position_cm, float velocity_cm_s, float error_cm,
+                    uint32_t timestamp_us);
+};
+
+#endif // POSITIONCONTROLLER_H
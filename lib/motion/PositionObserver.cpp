@@ -0,0 +1,105 @@
+/**
+ * @file PositionObserver.cpp
+ * @brief Implementation of dead-reckoning carriage position observer
+ */
+
+#include "PositionObserver.h"
+
+PositionObserver::PositionObserver(MotorDriver& motor, float position_gain, float velocity_gain,
+                                   float learning_rate)
+    : motor_(motor), position_gain_(position_gain), velocity_gain_(velocity_gain),
+      learning_rate_(learning_rate),
+      forward_gain_(0.25f), reverse_gain_(0.25f), deadband_(30), time_constant_s_(0.08f),
+      position_cm_(0.0f), velocity_cm_s_(0.0f), last_time_us_(0), locked_(false) {
+}
+
+void PositionObserver::setModel(float forward_gain, float reverse_gain, uint8_t deadband,
+                                uint32_t time_constant_ms) {
+    forward_gain_ = forward_gain;
+    reverse_gain_ = reverse_gain;
+    deadband_ = deadband;
+    time_constant_s_ = time_constant_ms / 1000.0f;
+}
+
+void PositionObserver::reset(float position_cm, uint32_t timestamp_us) {
+    position_cm_ = position_cm;
+    velocity_cm_s_ = 0.0f;
+    last_time_us_ = timestamp_us;
+    locked_ = true;
+}
+
+float PositionObserver::modelVelocity(uint8_t speed, MotorDriver::Direction dir) const {
+    if (speed <= deadband_) {
+        return 0.0f;
+    }
+    
+    switch (dir) {
+        case MotorDriver::FORWARD:
+            return forward_gain_ * (speed - deadband_);
+        case MotorDriver::REVERSE:
+            return -reverse_gain_ * (speed - deadband_);
+        default:
+            return 0.0f;
+    }
+}
+
+void PositionObserver::predict(uint32_t timestamp_us) {
+    float dt = (timestamp_us - last_time_us_) / 1000000.0f;
+    last_time_us_ = timestamp_us;
+    
+    if (!locked_ || dt <= 0.0f) {
+        return;
+    }
+    
+    float target_velocity = modelVelocity(motor_.getAppliedSpeed(), motor_.getAppliedDirection());
+    
+    // First-order motor lag
+    float blend = (time_constant_s_ > dt) ? dt / time_constant_s_ : 1.0f;
+    velocity_cm_s_ += (target_velocity - velocity_cm_s_) * blend;
+    position_cm_ += velocity_cm_s_ * dt;
+}
+
+void PositionObserver::correct(float position_cm, float velocity_cm_s, uint32_t timestamp_us) {
+    if (!locked_) {
+        position_cm_ = position_cm;
+        velocity_cm_s_ = velocity_cm_s;
+        last_time_us_ = timestamp_us;
+        locked_ = true;
+        return;
+    }
+    
+    predict(timestamp_us);
+    
+    position_cm_ += position_gain_ * (position_cm - position_cm_);
+    velocity_cm_s_ += velocity_gain_ * (velocity_cm_s - velocity_cm_s_);
+    
+    // Adapt the model only at steady duty, where the measured speed is the model speed
+    uint8_t speed = motor_.getAppliedSpeed();
+    MotorDriver::Direction dir = motor_.getAppliedDirection();
+    if (learning_rate_ <= 0.0f || motor_.isRamping() || speed < deadband_ + MIN_LEARN_EXCESS) {
+        return;  // Near the deadband the gain estimate is ill-conditioned
+    }
+    
+    float excess = speed - deadband_;
+    if (dir == MotorDriver::FORWARD && velocity_cm_s > MIN_LEARN_VELOCITY) {
+        forward_gain_ += learning_rate_ * (velocity_cm_s / excess - forward_gain_);
+    } else if (dir == MotorDriver::REVERSE && velocity_cm_s < -MIN_LEARN_VELOCITY) {
+        reverse_gain_ += learning_rate_ * (-velocity_cm_s / excess - reverse_gain_);
+    }
+}
+
+int32_t PositionObserver::predictCrossingTime(float target_cm) const {
+    float distance = target_cm - position_cm_;
+    
+    // Moving away from (or not toward) the target
+    if (velocity_cm_s_ == 0.0f || (distance > 0.0f) != (velocity_cm_s_ > 0.0f)) {
+        return -1;
+    }
+    
+    float seconds = distance / velocity_cm_s_;
+    if (seconds > 2000.0f) {
+        return -1;  // Too slow to matter (and beyond int32 microseconds)
+    }
+    
+    return (int32_t)(seconds * 1000000.0f);
+}
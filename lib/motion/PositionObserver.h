@@ -0,0 +1,115 @@
+/**
+ * @file PositionObserver.h
+ * @brief Dead-reckoning carriage position observer
+ * 
+ * Predicts carriage position between ultrasonic samples from the duty
+ * actually applied by MotorDriver and a learned duty-to-velocity model:
+ * 
+ *   v_model = gain[dir] * (duty - deadband)       (0 below deadband)
+ *   v      += (v_model - v) * dt / tau            (motor lag)
+ *   x      += v * dt
+ * 
+ * Every trusted sensor sample corrects position and velocity, and while
+ * the duty is steady it also adapts the per-direction gain toward the
+ * measured velocity.
+ */
+
+#ifndef POSITIONOBSERVER_H
+#define POSITIONOBSERVER_H
+
+#include "pico/stdlib.h"
+#include "MotorDriver.h"
+#include <cstdint>
+
+class PositionObserver {
+public:
+    /**
+     * @brief Constructor for position observer
+     * @param motor Motor whose applied duty drives the prediction
+     * @param position_gain Fraction of position error corrected per sample (0.0 - 1.0)
+     * @param velocity_gain Fraction of velocity error corrected per sample (0.0 - 1.0)
+     * @param learning_rate Gain adaptation rate per sample (0 = no learning)
+     */
+    PositionObserver(MotorDriver& motor, float position_gain, float velocity_gain,
+                     float learning_rate);
+    
+    /**
+     * @brief Set the duty-to-velocity model
+     * @param forward_gain Forward velocity per % duty above deadband (cm/s per %)
+     * @param reverse_gain Reverse velocity per % duty above deadband (cm/s per %)
+     * @param deadband Duty below which the carriage does not move (%)
+     * @param time_constant_ms Motor velocity lag in milliseconds
+     */
+    void setModel(float forward_gain, float reverse_gain, uint8_t deadband,
+                  uint32_t time_constant_ms);
+    
+    /**
+     * @brief Anchor the observer at a known position (at rest)
+     * @param position_cm Position in cm
+     * @param timestamp_us Current time in microseconds
+     */
+    void reset(float position_cm, uint32_t timestamp_us);
+    
+    /**
+     * @brief Forget the anchor (the next sample snaps the position)
+     */
+    void unlock() { locked_ = false; }
+    
+    /**
+     * @brief Advance the prediction to a new time
+     * @param timestamp_us Current time in microseconds
+     */
+    void predict(uint32_t timestamp_us);
+    
+    /**
+     * @brief Correct with a sensor sample
+     * @param position_cm Measured position in cm
+     * @param velocity_cm_s Measured velocity in cm/s
+     * @param timestamp_us Sample time in microseconds
+     */
+    void correct(float position_cm, float velocity_cm_s, uint32_t timestamp_us);
+    
+    /**
+     * @brief Predict when the carriage will cross a position
+     * @param target_cm Position in cm
+     * @return Microseconds until crossing at the current velocity, or -1 if
+     *         the carriage is not moving toward it
+     */
+    int32_t predictCrossingTime(float target_cm) const;
+    
+    /**
+     * @brief Get model velocity for a duty command
+     * @param speed Duty (0-100)
+     * @param dir Direction
+     * @return Steady-state velocity in cm/s (signed)
+     */
+    float modelVelocity(uint8_t speed, MotorDriver::Direction dir) const;
+    
+    bool isLocked() const { return locked_; }
+    float getPosition() const { return position_cm_; }
+    float getVelocity() const { return velocity_cm_s_; }
+    float getForwardGain() const { return forward_gain_; }
+    float getReverseGain() const { return reverse_gain_; }
+    
+private:
+    MotorDriver& motor_;
+    
+    float position_gain_;
+    float velocity_gain_;
+    float learning_rate_;
+    
+    float forward_gain_;
+    float reverse_gain_;
+    uint8_t deadband_;
+    float time_constant_s_;
+    
+    float position_cm_;
+    float velocity_cm_s_;
+    uint32_t last_time_us_;
+    bool locked_;
+    
+    static constexpr float MIN_LEARN_VELOCITY = 1.0f;  // cm/s, ignore slower samples
+    static constexpr uint8_t MIN_LEARN_EXCESS = 10;     // % duty above deadband to learn
+};
+
+#endif // POSITIONOBSERVER_H
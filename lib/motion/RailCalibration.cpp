@@ -0,0 +1,69 @@
+/**
+ * @file RailCalibration.cpp
+ * @brief Implementation of rail calibration record
+ */
+
+#include "RailCalibration.h"
+
+RailCalibration::RailCalibration(const Data& defaults)
+    : data_(defaults) {
+}
+
+uint8_t RailCalibration::dutyForVelocity(float velocity_cm_s, bool forward) const {
+    uint8_t min_duty = forward ? data_.min_duty_forward : data_.min_duty_reverse;
+    float gain = forward ? data_.gain_forward : data_.gain_reverse;
+    
+    if (velocity_cm_s <= 0.0f || gain <= 0.0f) {
+        return 0;
+    }
+    
+    float duty = min_duty + velocity_cm_s / gain;
+    return duty >= 100.0f ? 100 : (uint8_t)(duty + 0.5f);
+}
+
+float RailCalibration::fitGain(const uint8_t* duties, const float* velocities, uint8_t count,
+                               uint8_t min_duty) {
+    // v = gain * (duty - min_duty), fit through the origin
+    float sum_xv = 0.0f;
+    float sum_xx = 0.0f;
+    
+    for (uint8_t i = 0; i < count; i++) {
+        if (duties[i] <= min_duty || velocities[i] <= 0.0f) {
+            continue;
+        }
+        float excess = duties[i] - min_duty;
+        sum_xv += excess * velocities[i];
+        sum_xx += excess * excess;
+    }
+    
+    return (sum_xx > 0.0f) ? sum_xv / sum_xx : 0.0f;
+}
+
+bool RailCalibration::isValid() const {
+    for (uint8_t i = 1; i < NUM_STOPS; i++) {
+        if (data_.stops_cm[i] <= data_.stops_cm[i - 1]) {
+            return false;
+        }
+    }
+    
+    return data_.gain_forward > 0.0f && data_.gain_reverse > 0.0f &&
+           data_.min_duty_forward < 100 && data_.min_duty_reverse < 100;
+}
+
+bool RailCalibration::load(const FlashStore& store) {
+    RailCalibration loaded(data_);
+    if (!store.load(FLASH_MAGIC, FLASH_VERSION, &loaded.data_, sizeof(Data))) {
+        return false;
+    }
+    
+    if (!loaded.isValid()) {
+        return false;
+    }
+    
+    data_ = loaded.data_;
+    return true;
+}
+
+bool RailCalibration::save(FlashStore& store) const {
+    return store.save(FLASH_MAGIC, FLASH_VERSION, &data_, sizeof(Data));
+}
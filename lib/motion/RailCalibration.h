@@ -0,0 +1,96 @@
+/**
+ * @file RailCalibration.h
+ * @brief Measured rail geometry and motor response, persisted in flash
+ * 
+ * Holds the values that config.h only provides as defaults:
+ * - Stop positions (home and the three columns) as the sensor sees them
+ * - Minimum duty that starts motion, per direction
+ * - Velocity per % duty above that minimum, per direction
+ * 
+ * The values are measured by the rail calibration sweep in main.cpp and
+ * stored as a versioned FlashStore record. A record from an older layout
+ * is rejected and the defaults stay in use.
+ */
+
+#ifndef RAILCALIBRATION_H
+#define RAILCALIBRATION_H
+
+#include "pico/stdlib.h"
+#include "FlashStore.h"
+#include <cstdint>
+
+class RailCalibration {
+public:
+    static constexpr uint8_t NUM_STOPS = 4;  // Home, column 1-3
+    
+    /**
+     * @brief Calibrated values
+     */
+    struct Data {
+        float stops_cm[NUM_STOPS];   // Stop positions (index 0 = home)
+        uint8_t min_duty_forward;    // Lowest duty that starts forward motion (%)
+        uint8_t min_duty_reverse;    // Lowest duty that starts reverse motion (%)
+        float gain_forward;          // cm/s per % above min duty, forward
+        float gain_reverse;          // cm/s per % above min duty, reverse
+    };
+    
+    /**
+     * @brief Constructor for rail calibration
+     * @param defaults Values to use until a record is loaded
+     */
+    RailCalibration(const Data& defaults);
+    
+    /**
+     * @brief Access calibrated values
+     * @return Current values
+     */
+    Data& data() { return data_; }
+    const Data& data() const { return data_; }
+    
+    /**
+     * @brief Get the duty needed for a velocity
+     * @param velocity_cm_s Desired speed (unsigned)
+     * @param forward true for forward, false for reverse
+     * @return Duty (0-100)
+     */
+    uint8_t dutyForVelocity(float velocity_cm_s, bool forward) const;
+    
+    /**
+     * @brief Fit velocity per % duty through the deadband (least squares)
+     * @param duties Duty of each measurement (%)
+     * @param velocities Measured speed of each measurement (cm/s, unsigned)
+     * @param count Number of measurements
+     * @param min_duty Deadband duty
+     * @return Gain in cm/s per %, or 0 if nothing usable was measured
+     */
+    static float fitGain(const uint8_t* duties, const float* velocities, uint8_t count,
+                         uint8_t min_duty);
+    
+    /**
+     * @brief Check the values are physically sensible
+     * @return true if stops are increasing and gains positive
+     */
+    bool isValid() const;
+    
+    /**
+     * @brief Load values from flash
+     * @param store Flash sector holding the record
+     * @return true if a valid record was loaded
+     */
+    bool load(const FlashStore& store);
+    
+    /**
+     * @brief Save values to flash
+     * @param store Flash sector to write
+     * @return true on success
+     */
+    bool save(FlashStore& store) const;
+    
+private:
+    Data data_;
+    
+    static constexpr uint32_t FLASH_MAGIC = 0x5241494C;  // "RAIL"
+    static constexpr uint16_t FLASH_VERSION = 1;
+};
+
+#endif // RAILCALIBRATION_H
@@ -0,0 +1,69 @@
+/**
+ * @file StopDistanceModel.cpp
+ * @brief Implementation of learned stopping distance model
+ */
+
+#include "StopDistanceModel.h"
+
+StopDistanceModel::StopDistanceModel(float max_speed_cm_s, float learning_rate)
+    : bin_width_cm_s_(max_speed_cm_s / (NUM_BINS - 1)), learning_rate_(learning_rate),
+      samples_(0) {
+    reset();
+}
+
+void StopDistanceModel::reset() {
+    for (uint8_t i = 0; i < NUM_BINS; i++) {
+        forward_cm_[i] = 0.0f;
+        reverse_cm_[i] = 0.0f;
+    }
+    samples_ = 0;
+}
+
+float StopDistanceModel::predict(float velocity_cm_s) const {
+    const float* table = velocity_cm_s >= 0.0f ? forward_cm_ : reverse_cm_;
+    
+    float fraction;
+    uint8_t bin = findBin(velocity_cm_s, &fraction);
+    return table[bin] + (table[bin + 1] - table[bin]) * fraction;
+}
+
+void StopDistanceModel::learn(float velocity_cm_s, float distance_cm) {
+    float* table = velocity_cm_s >= 0.0f ? forward_cm_ : reverse_cm_;
+    
+    if (distance_cm < 0.0f) {
+        distance_cm = 0.0f;  // Sensor noise around a very short stop
+    }
+    
+    // Share the correction between the two bins by interpolation weight
+    float fraction;
+    uint8_t bin = findBin(velocity_cm_s, &fraction);
+    float error = distance_cm - predict(velocity_cm_s);
+    
+    table[bin] += learning_rate_ * (1.0f - fraction) * error;
+    table[bin + 1] += learning_rate_ * fraction * error;
+    
+    if (table[bin] < 0.0f) {
+        table[bin] = 0.0f;
+    }
+    if (table[bin + 1] < 0.0f) {
+        table[bin + 1] = 0.0f;
+    }
+    
+    if (samples_ < UINT16_MAX) {
+        samples_++;
+    }
+}
+
+uint8_t StopDistanceModel::findBin(float velocity_cm_s, float* fraction) const {
+    float speed = velocity_cm_s < 0.0f ? -velocity_cm_s : velocity_cm_s;
+    float position = speed / bin_width_cm_s_;
+    
+    if (position >= NUM_BINS - 1) {
+        *fraction = 1.0f;
+        return NUM_BINS - 2;
+    }
+    
+    uint8_t bin = (uint8_t)position;
+    *fraction = position - bin;
+    return bin;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file StopDistanceModel.h
+ * @brief Learned stopping distance of the carriage per speed and direction
+ * 
+ * Once the motor is told to stop, the carriage keeps moving for a while
+ * (motor lag, ramp-down, coasting or braking). This model holds the
+ * distance travelled after a stop command as a table over speed, one
+ * table per direction, and interpolates linearly between the bins.
+ * 
+ * The tables start at zero (no compensation) and are learned online:
+ * after each stop, the distance actually travelled between the stop
+ * command and the carriage coming to rest is fed back through learn(),
+ * which moves the two surrounding bins toward it.
+ * 
+ * The distances depend on the motor brake mode, so keep the mode fixed
+ * (or reset() the model when changing it).
+ */
+
+#ifndef STOPDISTANCEMODEL_H
+#define STOPDISTANCEMODEL_H
+
+#include "pico/stdlib.h"
+#include <cstdint>
+
+class StopDistanceModel {
+public:
+    static constexpr uint8_t NUM_BINS = 8;
+    
+    /**
+     * @brief Constructor for stop distance model
+     * @param max_speed_cm_s Speed of the last bin (faster speeds use it too)
+     * @param learning_rate Fraction of the error corrected per stop (0.0 - 1.0)
+     */
+    StopDistanceModel(float max_speed_cm_s, float learning_rate);
+    
+    /**
+     * @brief Forget everything learned
+     */
+    void reset();
+    
+    /**
+     * @brief Predict the distance travelled after a stop command
+     * @param velocity_cm_s Velocity when stopping (sign selects direction)
+     * @return Stopping distance in cm (always >= 0)
+     */
+    float predict(float velocity_cm_s) const;
+    
+    /**
+     * @brief Learn from a completed stop
+     * @param velocity_cm_s Velocity when the stop was commanded
+     * @param distance_cm Distance travelled until at rest (in the direction of motion)
+     */
+    void learn(float velocity_cm_s, float distance_cm);
+    
+    /**
+     * @brief Get number of stops learned so far
+     * @return Stop count
+     */
+    uint16_t getSampleCount() const { return samples_; }
+    
+private:
+    float bin_width_cm_s_;
+    float learning_rate_;
+    float forward_cm_[NUM_BINS];
+    float reverse_cm_[NUM_BINS];
+    uint16_t samples_;
+    
+    /**
+     * @brief Locate a speed in the table
+     * @param velocity_cm_s Velocity (sign ignored)
+     * @param fraction Output: position between bin and bin + 1 (0.0 - 1.0)
+     * @return Lower bin index
+     */
+    uint8_t findBin(float velocity_cm_s, float* fraction) const;
+};
+
+#endif // STOPDISTANCEMODEL_H
@@ -0,0 +1,51 @@
+/**
+ * @file MotionPlanner.cpp
+ * @brief Implementation of precomputed stop-to-stop motion profiles
+ */
+
+#include "MotionPlanner.h"
+
+MotionPlanner::MotionPlanner(float max_velocity, float max_accel, float max_jerk)
+    : max_velocity_(max_velocity), max_accel_(max_accel), max_jerk_(max_jerk),
+      stop_count_(0) {
+}
+
+void MotionPlanner::precompute(const float* positions, uint8_t count) {
+    if (count > MAX_STOPS) {
+        count = MAX_STOPS;
+    }
+    
+    stop_count_ = count;
+    for (uint8_t i = 0; i < count; i++) {
+        stops_[i] = positions[i];
+    }
+    
+    for (uint8_t from = 0; from < count; from++) {
+        for (uint8_t to = 0; to < count; to++) {
+            profiles_[from][to].plan(stops_[from], stops_[to],
+                                     max_velocity_, max_accel_, max_jerk_);
+        }
+    }
+}
+
+const MotionProfile& MotionPlanner::plan(float from_cm, float to_cm, float match_cm) {
+    int8_t from = findStop(from_cm, match_cm);
+    int8_t to = findStop(to_cm, match_cm);
+    
+    if (from >= 0 && to >= 0) {
+        return profiles_[from][to];
+    }
+    
+    scratch_.plan(from_cm, to_cm, max_velocity_, max_accel_, max_jerk_);
+    return scratch_;
+}
+
+int8_t MotionPlanner::findStop(float position_cm, float match_cm) const {
+    for (uint8_t i = 0; i < stop_count_; i++) {
+        float diff = position_cm - stops_[i];
+        if (diff >= -match_cm && diff <= match_cm) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file MotionPlanner.h
+ * @brief Precomputed motion profiles between the rail stops
+ * 
+ * Holds one MotionProfile for every ordered pair of stops (home and the
+ * columns), planned once at startup by precompute(). Moves that start
+ * away from a known stop (e.g. after a failed move) are planned on
+ * demand into a scratch profile.
+ */
+
+#ifndef MOTIONPLANNER_H
+#define MOTIONPLANNER_H
+
+#include "pico/stdlib.h"
+#include "MotionProfile.h"
+#include <cstdint>
+
+class MotionPlanner {
+public:
+    static constexpr uint8_t MAX_STOPS = 4;
+    
+    /**
+     * @brief Constructor for motion planner
+     * @param max_velocity Velocity limit in cm/s
+     * @param max_accel Acceleration limit in cm/s^2
+     * @param max_jerk Jerk limit in cm/s^3 (0 = trapezoidal)
+     */
+    MotionPlanner(float max_velocity, float max_accel, float max_jerk);
+    
+    /**
+     * @brief Set stop positions and plan all stop-to-stop profiles
+     * @param positions Stop positions in cm
+     * @param count Number of stops (up to MAX_STOPS)
+     */
+    void precompute(const float* positions, uint8_t count);
+    
+    /**
+     * @brief Get profile between two stops
+     * @param from Start stop index
+     * @param to End stop index
+     * @return Precomputed profile
+     */
+    const MotionProfile& getProfile(uint8_t from, uint8_t to) const {
+        return profiles_[from][to];
+    }
+    
+    /**
+     * @brief Get profile for an arbitrary move
+     * Uses a precomputed profile when start and end are within
+     * match_cm of known stops; otherwise plans into a scratch profile.
+     * @param from_cm Start position in cm
+     * @param to_cm End position in cm
+     * @param match_cm Distance within which a position counts as a stop
+     * @return Profile for the move (valid until the next call)
+     */
+    const MotionProfile& plan(float from_cm, float to_cm, float match_cm);
+    
+private:
+    float max_velocity_;
+    float max_accel_;
+    float max_jerk_;
+    
+    float stops_[MAX_STOPS];
+    uint8_t stop_count_;
+    MotionProfile profiles_[MAX_STOPS][MAX_STOPS];
+    MotionProfile scratch_;
+    
+    /**
+     * @brief Find the stop near a position
+     * @param position_cm Position in cm
+     * @param match_cm Match distance
+     * @return Stop index, or -1 if none
+     */
+    int8_t findStop(float position_cm, float match_cm) const;
+};
+
+#endif // MOTIONPLANNER_H
@@ -0,0 +1,137 @@
+/**
+ * @file MotionProfile.cpp
+ * @brief Implementation of S-curve / trapezoidal velocity profile
+ */
+
+#include "MotionProfile.h"
+#include <cmath>
+
+MotionProfile::MotionProfile()
+    : start_cm_(0.0f), end_cm_(0.0f), direction_(1.0f),
+      peak_velocity_(0.0f), duration_us_(0) {
+    for (uint8_t i = 0; i < NUM_SEGMENTS; i++) {
+        segments_[i] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    }
+}
+
+float MotionProfile::accelPhase(float peak_velocity, float max_accel, float max_jerk,
+                                float& jerk_time, float& accel_time, float& peak_accel) {
+    if (max_jerk > 0.0f && peak_velocity * max_jerk < max_accel * max_accel) {
+        // Acceleration limit never reached: pure jerk up / jerk down
+        jerk_time = sqrtf(peak_velocity / max_jerk);
+        accel_time = 0.0f;
+        peak_accel = max_jerk * jerk_time;
+    } else {
+        jerk_time = (max_jerk > 0.0f) ? max_accel / max_jerk : 0.0f;
+        accel_time = peak_velocity / max_accel - jerk_time;
+        peak_accel = max_accel;
+    }
+    
+    // Symmetric acceleration phase covers half of peak velocity * its duration
+    return peak_velocity * (2.0f * jerk_time + accel_time) / 2.0f;
+}
+
+void MotionProfile::plan(float start_cm, float end_cm,
+                         float max_velocity, float max_accel, float max_jerk) {
+    start_cm_ = start_cm;
+    end_cm_ = end_cm;
+    direction_ = (end_cm >= start_cm) ? 1.0f : -1.0f;
+    
+    float distance = (end_cm - start_cm) * direction_;
+    float jerk_time = 0.0f;
+    float accel_time = 0.0f;
+    float peak_accel = 0.0f;
+    float cruise_time = 0.0f;
+    float peak_velocity = max_velocity;
+    
+    if (distance <= 0.0f || max_velocity <= 0.0f || max_accel <= 0.0f) {
+        peak_velocity = 0.0f;
+    } else {
+        float accel_distance = accelPhase(peak_velocity, max_accel, max_jerk,
+                                          jerk_time, accel_time, peak_accel);
+        
+        if (2.0f * accel_distance <= distance) {
+            cruise_time = (distance - 2.0f * accel_distance) / peak_velocity;
+        } else {
+            // Velocity limit not reachable: find the peak that fits exactly
+            float low = 0.0f;
+            float high = max_velocity;
+            for (uint8_t i = 0; i < 24; i++) {
+                peak_velocity = (low + high) / 2.0f;
+                accel_distance = accelPhase(peak_velocity, max_accel, max_jerk,
+                                            jerk_time, accel_time, peak_accel);
+                if (2.0f * accel_distance > distance) {
+                    high = peak_velocity;
+                } else {
+                    low = peak_velocity;
+                }
+            }
+            peak_velocity = low;
+            accel_distance = accelPhase(peak_velocity, max_accel, max_jerk,
+                                        jerk_time, accel_time, peak_accel);
+            cruise_time = (distance - 2.0f * accel_distance) / peak_velocity;
+        }
+    }
+    
+    peak_velocity_ = peak_velocity;
+    
+    // Segment layout (durations, jerks and the acceleration each starts with)
+    float durations[NUM_SEGMENTS] = {jerk_time, accel_time, jerk_time, cruise_time,
+                                     jerk_time, accel_time, jerk_time};
+    float jerks[NUM_SEGMENTS] = {max_jerk, 0.0f, -max_jerk, 0.0f, -max_jerk, 0.0f, max_jerk};
+    float accels[NUM_SEGMENTS] = {0.0f, peak_accel, peak_accel, 0.0f,
+                                  0.0f, -peak_accel, -peak_accel};
+    if (peak_velocity <= 0.0f) {
+        for (uint8_t i = 0; i < NUM_SEGMENTS; i++) {
+            durations[i] = 0.0f;
+            accels[i] = 0.0f;
+        }
+    }
+    
+    // Integrate segment start states (trapezoid: accel steps between segments)
+    float velocity = 0.0f;
+    float position = 0.0f;
+    float total = 0.0f;
+    for (uint8_t i = 0; i < NUM_SEGMENTS; i++) {
+        float t = durations[i];
+        float a = accels[i];
+        float j = (max_jerk > 0.0f) ? jerks[i] : 0.0f;
+        
+        segments_[i] = {t, j, a, velocity, position};
+        
+        position += velocity * t + a * t * t / 2.0f + j * t * t * t / 6.0f;
+        velocity += a * t + j * t * t / 2.0f;
+        total += t;
+    }
+    
+    duration_us_ = (uint32_t)(total * 1000000.0f + 0.5f);
+}
+
+MotionSample MotionProfile::sample(uint32_t elapsed_us) const {
+    MotionSample result = {end_cm_, 0.0f, 0.0f};
+    
+    if (elapsed_us >= duration_us_) {
+        return result;
+    }
+    
+    float t = elapsed_us / 1000000.0f;
+    for (uint8_t i = 0; i < NUM_SEGMENTS; i++) {
+        const Segment& seg = segments_[i];
+        if (t > seg.duration && i < NUM_SEGMENTS - 1) {
+            t -= seg.duration;
+            continue;
+        }
+        
+        float position = seg.position + seg.velocity * t + seg.accel * t * t / 2.0f
+                         + seg.jerk * t * t * t / 6.0f;
+        float velocity = seg.velocity + seg.accel * t + seg.jerk * t * t / 2.0f;
+        float accel = seg.accel + seg.jerk * t;
+        
+        result.position_cm = start_cm_ + direction_ * position;
+        result.velocity_cm_s = direction_ * velocity;
+        result.accel_cm_s2 = direction_ * accel;
+        break;
+    }
+    
+    return result;
+}
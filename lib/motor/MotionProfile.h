@@ -0,0 +1,105 @@
+/**
+ * @file MotionProfile.h
+ * @brief Jerk-limited (S-curve) or trapezoidal point-to-point velocity profile
+ * 
+ * Plans a rest-to-rest move with velocity, acceleration and jerk limits
+ * as seven constant-jerk segments:
+ * 
+ *   jerk up | accel | jerk down | cruise | jerk down | decel | jerk up
+ * 
+ * With jerk limit 0 the jerk segments vanish and the profile is
+ * trapezoidal. Short moves that cannot reach the velocity limit use the
+ * highest peak velocity that still fits the distance.
+ * 
+ * Planning uses float math and a short bisection, so do it ahead of time
+ * (see MotionPlanner); sample() is cheap and can run every control step.
+ */
+
+#ifndef MOTIONPROFILE_H
+#define MOTIONPROFILE_H
+
+#include "pico/stdlib.h"
+#include <cstdint>
+
+/**
+ * @brief Reference state at one point of a profile
+ */
+struct MotionSample {
+    float position_cm;     // Reference position
+    float velocity_cm_s;   // Reference velocity (signed)
+    float accel_cm_s2;     // Reference acceleration (signed)
+};
+
+class MotionProfile {
+public:
+    MotionProfile();
+    
+    /**
+     * @brief Plan a move
+     * @param start_cm Start position in cm
+     * @param end_cm End position in cm
+     * @param max_velocity Velocity limit in cm/s
+     * @param max_accel Acceleration limit in cm/s^2
+     * @param max_jerk Jerk limit in cm/s^3 (0 = trapezoidal)
+     */
+    void plan(float start_cm, float end_cm,
+              float max_velocity, float max_accel, float max_jerk);
+    
+    /**
+     * @brief Get reference state at a time into the move
+     * @param elapsed_us Time since the move started in microseconds
+     * @return Reference state (holds the end position after the move)
+     */
+    MotionSample sample(uint32_t elapsed_us) const;
+    
+    /**
+     * @brief Get total move time
+     * @return Duration in microseconds
+     */
+    uint32_t getDurationUs() const { return duration_us_; }
+    
+    /**
+     * @brief Get peak velocity actually reached
+     * @return Peak speed in cm/s (unsigned)
+     */
+    float getPeakVelocity() const { return peak_velocity_; }
+    
+    float getStart() const { return start_cm_; }
+    float getEnd() const { return end_cm_; }
+    
+private:
+    static constexpr uint8_t NUM_SEGMENTS = 7;
+    
+    /**
+     * @brief State at the start of a constant-jerk segment
+     */
+    struct Segment {
+        float duration;  // s
+        float jerk;      // cm/s^3
+        float accel;     // cm/s^2 at segment start
+        float velocity;  // cm/s at segment start
+        float position;  // cm from start at segment start
+    };
+    
+    Segment segments_[NUM_SEGMENTS];
+    float start_cm_;
+    float end_cm_;
+    float direction_;
+    float peak_velocity_;
+    uint32_t duration_us_;
+    
+    /**
+     * @brief Compute phase durations for a given peak velocity
+     * @param peak_velocity Peak velocity (cm/s)
+     * @param max_accel Acceleration limit
+     * @param max_jerk Jerk limit (0 = infinite)
+     * @param jerk_time Output: duration of each jerk segment (s)
+     * @param accel_time Output: duration of constant-accel segment (s)
+     * @param peak_accel Output: acceleration reached
+     * @return Distance covered while accelerating to peak_velocity
+     */
+    static float accelPhase(float peak_velocity, float max_accel, float max_jerk,
+                            float& jerk_time, float& accel_time, float& peak_accel);
+};
+
+#endif // MOTIONPROFILE_H
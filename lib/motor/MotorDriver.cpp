@@ -4,11 +4,22 @@
  */
 
 #include "MotorDriver.h"
+#include "PwmWrapIrq.h"
+#include "hardware/sync.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
 
 MotorDriver::MotorDriver(uint8_t in1_pin, uint8_t in2_pin, uint8_t ena_pin)
     : in1_pin_(in1_pin), in2_pin_(in2_pin), ena_pin_(ena_pin),
-      current_speed_(0), current_direction_(BRAKE),
-      move_start_time_(0), move_duration_(0), timed_move_active_(false) {
+      current_speed_(0), current_direction_(BRAKE), brake_mode_(COAST),
+      move_start_time_(0), move_duration_(0), timed_move_active_(false),
+      target_level_q16_(0), applied_level_q16_(0), ramp_step_q16_(0),
+      applied_direction_(BRAKE),
+      sense_buffer_(), sense_restart_addr_(sense_buffer_),
+      sense_dma_channel_(-1), sense_restart_channel_(-1), ma_per_count_(0.0f),
+      current_ma_(0), overcurrent_ma_(UINT16_MAX), stall_ma_(UINT16_MAX),
+      stall_us_(0), stall_start_us_(0), stall_timing_(false) {
 }
 
 void MotorDriver::init() {
@@ -27,15 +38,34 @@ void MotorDriver::init() {
     pwm_channel_ = pwm_gpio_to_channel(ena_pin_);
     
     // Set PWM frequency
-    // Clock speed / (wrap + 1) = frequency
-    // 125MHz / (999 + 1) / divider = 1kHz
-    // divider = 125
-    pwm_set_clkdiv(pwm_slice_, 125.0f);
-    pwm_set_wrap(pwm_slice_, PWM_WRAP);
+    // Clock speed / (wrap + 1) / divider = frequency
+    // divider = clk_sys / (1kHz * 1000), in the divider's 1/16 steps
+    // (125MHz -> 125, 133MHz -> 133)
+    uint64_t clk_16ths = (uint64_t)clock_get_hz(clk_sys) * 16u;
+    uint32_t counts_per_second = PWM_FREQ_HZ * (PWM_WRAP + 1u);
+    uint32_t divider_16ths = (uint32_t)((clk_16ths + counts_per_second / 2) / counts_per_second);
+    uint32_t wrap = PWM_WRAP;
+    if (divider_16ths < 16) {
+        divider_16ths = 16;
+    } else if (divider_16ths > 0xFFF) {
+        // Overclocked past ~256MHz: the divider tops out, so keep 1kHz with
+        // a longer wrap (updatePWM and the ramp scale with the real TOP)
+        divider_16ths = 0xFFF;
+        uint64_t counts_per_period = (uint64_t)PWM_FREQ_HZ * divider_16ths;
+        wrap = (uint32_t)((clk_16ths + counts_per_period / 2) / counts_per_period) - 1u;
+        if (wrap > UINT16_MAX) {
+            wrap = UINT16_MAX;
+        }
+    }
+    pwm_set_clkdiv_int_frac(pwm_slice_, (uint8_t)(divider_16ths >> 4), (uint8_t)(divider_16ths & 0xF));
+    pwm_set_wrap(pwm_slice_, (uint16_t)wrap);
     
     // Start with motor stopped
     pwm_set_chan_level(pwm_slice_, pwm_channel_, 0);
     pwm_set_enabled(pwm_slice_, true);
+    
+    // Register for wrap interrupts (enabled only while ramping)
+    PwmWrapIrq::attach(pwm_slice_, pwm_channel_, onPwmWrap, this);
 }
 
 void MotorDriver::setSpeed(uint8_t speed) {
@@ -51,21 +81,10 @@ void MotorDriver::setSpeed(uint8_t speed) {
 void MotorDriver::setDirection(Direction dir) {
     current_direction_ = dir;
     
-    switch (dir) {
-        case FORWARD:
-            gpio_put(in1_pin_, 1);
-            gpio_put(in2_pin_, 0);
-            break;
-            
-        case REVERSE:
-            gpio_put(in1_pin_, 0);
-            gpio_put(in2_pin_, 1);
-            break;
-            
-        case BRAKE:
-            gpio_put(in1_pin_, 0);
-            gpio_put(in2_pin_, 0);
-            break;
+    if (ramp_step_q16_ != 0) {
+        updatePWM();  // Pins switch when the ramp passes through zero
+    } else {
+        writeDirection(dir);
     }
 }
 
@@ -80,6 +99,189 @@ void MotorDriver::stop() {
     timed_move_active_ = false;
 }
 
+void MotorDriver::brakeNow() {
+    haltNow(brakeLevel());
+}
+
+void MotorDriver::haltNow(uint16_t level) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    current_speed_ = 0;
+    current_direction_ = BRAKE;
+    timed_move_active_ = false;
+    
+    // Drop the ramp and stop on the spot
+    PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, false);
+    target_level_q16_ = 0;
+    applied_level_q16_ = 0;
+    writeDirection(BRAKE);
+    pwm_set_chan_level(pwm_slice_, pwm_channel_, level);
+    restore_interrupts(irq_state);
+}
+
+bool MotorDriver::initCurrentSense(uint8_t adc_pin, float sense_ohms) {
+    sense_dma_channel_ = dma_claim_unused_channel(false);
+    sense_restart_channel_ = dma_claim_unused_channel(false);
+    if (sense_dma_channel_ < 0 || sense_restart_channel_ < 0) {
+        if (sense_dma_channel_ >= 0) {
+            dma_channel_unclaim(sense_dma_channel_);
+        }
+        sense_dma_channel_ = -1;
+        sense_restart_channel_ = -1;
+        return false;
+    }
+    
+    // mA per count: 3.3V / 4096 counts / R
+    ma_per_count_ = 3300.0f / 4096.0f / sense_ohms;
+    
+    // The ADC may already be running for the temperature sensor
+    if (!(adc_hw->cs & ADC_CS_EN_BITS)) {
+        adc_init();
+    }
+    adc_gpio_init(adc_pin);
+    adc_select_input(adc_pin - 26);
+    adc_fifo_setup(true,    // Write conversions to the FIFO
+                   true,    // DREQ for the DMA
+                   1,       // DREQ on every sample
+                   false,   // No error bit
+                   false);  // Full 12-bit samples
+    adc_set_clkdiv(48000000.0f / SENSE_SAMPLE_RATE_HZ - 1.0f);
+    
+    // Data channel: FIFO -> ring buffer, one lap per trigger
+    dma_channel_config data_config = dma_channel_get_default_config(sense_dma_channel_);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&data_config, false);
+    channel_config_set_write_increment(&data_config, true);
+    channel_config_set_ring(&data_config, true, SENSE_RING_BITS);
+    channel_config_set_dreq(&data_config, DREQ_ADC);
+    channel_config_set_chain_to(&data_config, sense_restart_channel_);
+    dma_channel_configure(sense_dma_channel_, &data_config, sense_buffer_, &adc_hw->fifo,
+                          SENSE_BUFFER_SAMPLES, false);
+    
+    // Restart channel: rewrite the data channel's write address and retrigger
+    dma_channel_config restart_config = dma_channel_get_default_config(sense_restart_channel_);
+    channel_config_set_transfer_data_size(&restart_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&restart_config, false);
+    channel_config_set_write_increment(&restart_config, false);
+    dma_channel_configure(sense_restart_channel_, &restart_config,
+                          &dma_channel_hw_addr(sense_dma_channel_)->al2_write_addr_trig,
+                          &sense_restart_addr_, 1, false);
+    
+    dma_start_channel_mask(1u << sense_dma_channel_);
+    adc_run(true);
+    return true;
+}
+
+void MotorDriver::setCurrentLimits(uint16_t overcurrent_ma, uint16_t stall_ma,
+                                   uint32_t stall_ms) {
+    overcurrent_ma_ = overcurrent_ma;
+    stall_ma_ = stall_ma;
+    stall_us_ = stall_ms * 1000;
+}
+
+uint8_t MotorDriver::updateCurrent() {
+    if (sense_dma_channel_ < 0) {
+        return 0;
+    }
+    
+    // Average the newest PWM period behind the DMA write pointer
+    uint32_t window = senseWindow();
+    uint32_t write_addr = dma_channel_hw_addr(sense_dma_channel_)->write_addr;
+    uint32_t next = (write_addr - (uintptr_t)sense_buffer_) / sizeof(uint16_t);
+    uint32_t sum = 0;
+    for (uint32_t i = 1; i <= window; i++) {
+        sum += sense_buffer_[(next - i) & (SENSE_BUFFER_SAMPLES - 1)];
+    }
+    current_ma_ = (uint16_t)(sum * ma_per_count_ / window);
+    
+    uint8_t events = 0;
+    uint32_t now = time_us_32();
+    
+    if (current_ma_ >= overcurrent_ma_) {
+        events |= CURRENT_OVERLOAD;
+    }
+    
+    // Stall: driven hard without the current dropping
+    if (applied_level_q16_ != 0 && current_ma_ >= stall_ma_) {
+        if (!stall_timing_) {
+            stall_timing_ = true;
+            stall_start_us_ = now;
+        } else if ((now - stall_start_us_) >= stall_us_) {
+            events |= CURRENT_STALL;
+        }
+    } else {
+        stall_timing_ = false;
+    }
+    
+    if (events != 0) {
+        haltNow(0);  // Bridge off, no braking current
+        stall_timing_ = false;
+    }
+    return events;
+}
+
+void MotorDriver::setBrakeMode(BrakeMode mode) {
+    brake_mode_ = mode;
+    
+    // Re-apply ENA if the motor is braking right now
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (applied_direction_ == BRAKE && applied_level_q16_ == 0) {
+        pwm_set_chan_level(pwm_slice_, pwm_channel_, brakeLevel());
+    }
+    restore_interrupts(irq_state);
+}
+
+uint32_t MotorDriver::getPwmFrequencyHz() const {
+    // f = clk_sys / (divider * (TOP + 1)), divider in 1/16 steps (8.4 fixed point)
+    uint32_t divider_16ths = pwm_hw->slice[pwm_slice_].div &
+                             (PWM_CH0_DIV_INT_BITS | PWM_CH0_DIV_FRAC_BITS);
+    if (divider_16ths == 0) {
+        divider_16ths = 256u << 4;  // INT = 0 means divide by 256
+    }
+    uint64_t counts = (uint64_t)divider_16ths * (pwmTop() + 1u);
+    return (uint32_t)(((uint64_t)clock_get_hz(clk_sys) * 16u + counts / 2) / counts);
+}
+
+uint32_t MotorDriver::senseWindow() const {
+    // Samples per PWM period at the slice's real frequency, rounded
+    uint32_t frequency_hz = getPwmFrequencyHz();
+    if (frequency_hz == 0) {
+        return SENSE_BUFFER_SAMPLES;
+    }
+    uint32_t window = (SENSE_SAMPLE_RATE_HZ + frequency_hz / 2) / frequency_hz;
+    if (window < 1) {
+        window = 1;  // PWM faster than the sample rate: use the latest sample
+    } else if (window > SENSE_BUFFER_SAMPLES) {
+        window = SENSE_BUFFER_SAMPLES;
+    }
+    return window;
+}
+
+void MotorDriver::setRampRate(uint16_t percent_per_second) {
+    // Level change per PWM period in Q16
+    uint32_t frequency_hz = getPwmFrequencyHz();
+    ramp_step_q16_ = (int32_t)(((uint64_t)percent_per_second * pwmTop() * 65536u) /
+                               (100u * (uint64_t)(frequency_hz > 0 ? frequency_hz : 1)));
+    if (percent_per_second > 0 && ramp_step_q16_ == 0) {
+        ramp_step_q16_ = 1;
+    }
+    
+    if (ramp_step_q16_ == 0) {
+        // Finish any ramp in progress instantly
+        PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, false);
+        writeDirection(current_direction_);
+        updatePWM();
+    }
+}
+
+uint8_t MotorDriver::getAppliedSpeed() const {
+    int32_t level_q16 = applied_level_q16_;
+    if (level_q16 < 0) {
+        level_q16 = -level_q16;
+    }
+    uint32_t top = pwmTop();
+    return (uint8_t)((((uint32_t)level_q16 >> 16) * 100 + top / 2) / top);
+}
+
 void MotorDriver::moveFor(uint8_t speed, Direction dir, uint32_t duration_ms) {
     run(speed, dir);
     move_start_time_ = to_ms_since_boot(get_absolute_time());
@@ -104,7 +306,101 @@ bool MotorDriver::isMovementComplete() {
 }
 
 void MotorDriver::updatePWM() {
-    // Convert speed percentage to PWM level (0-PWM_WRAP)
-    uint16_t pwm_level = (current_speed_ * PWM_WRAP) / 100;
-    pwm_set_chan_level(pwm_slice_, pwm_channel_, pwm_level);
+    // Convert speed percentage to PWM level (0-TOP)
+    uint16_t pwm_level = (uint16_t)((current_speed_ * (uint32_t)pwmTop()) / 100);
+    
+    int32_t target_q16 = (int32_t)pwm_level << 16;
+    if (current_direction_ == REVERSE) {
+        target_q16 = -target_q16;
+    } else if (current_direction_ == BRAKE) {
+        target_q16 = 0;
+    }
+    
+    if (ramp_step_q16_ == 0) {
+        target_level_q16_ = target_q16;
+        applied_level_q16_ = target_q16;
+        if (current_direction_ == BRAKE) {
+            pwm_level = brakeLevel();
+        }
+        pwm_set_chan_level(pwm_slice_, pwm_channel_, pwm_level);
+        return;
+    }
+    
+    // Hand the new target to the wrap IRQ
+    uint32_t irq_state = save_and_disable_interrupts();
+    target_level_q16_ = target_q16;
+    if (applied_level_q16_ != target_q16) {
+        PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, true);
+    } else if (target_q16 == 0) {
+        writeDirection(current_direction_);  // Already stopped: apply brake/direction now
+        if (current_direction_ == BRAKE) {
+            pwm_set_chan_level(pwm_slice_, pwm_channel_, brakeLevel());
+        }
+    }
+    restore_interrupts(irq_state);
+}
+
+void MotorDriver::writeDirection(Direction dir) {
+    applied_direction_ = dir;
+    
+    switch (dir) {
+        case FORWARD:
+            gpio_put(in1_pin_, 1);
+            gpio_put(in2_pin_, 0);
+            break;
+            
+        case REVERSE:
+            gpio_put(in1_pin_, 0);
+            gpio_put(in2_pin_, 1);
+            break;
+            
+        case BRAKE:
+            gpio_put(in1_pin_, 0);
+            gpio_put(in2_pin_, 0);
+            break;
+    }
+}
+
+void MotorDriver::rampStep() {
+    int32_t target = target_level_q16_;
+    int32_t applied = applied_level_q16_;
+    int32_t next;
+    
+    if (applied < target) {
+        next = (target - applied > ramp_step_q16_) ? applied + ramp_step_q16_ : target;
+    } else {
+        next = (applied - target > ramp_step_q16_) ? applied - ramp_step_q16_ : target;
+    }
+    
+    // Reversal: stop for one period at zero before switching the pins
+    if ((applied > 0 && next < 0) || (applied < 0 && next > 0)) {
+        next = 0;
+    }
+    
+    Direction dir;
+    if (next > 0) {
+        dir = FORWARD;
+    } else if (next < 0) {
+        dir = REVERSE;
+    } else {
+        dir = current_direction_;
+    }
+    if (dir != applied_direction_) {
+        writeDirection(dir);
+    }
+    
+    uint32_t level = (uint32_t)(next < 0 ? -next : next) >> 16;
+    if (next == 0 && dir == BRAKE) {
+        level = brakeLevel();
+    }
+    pwm_set_chan_level(pwm_slice_, pwm_channel_, (uint16_t)level);
+    applied_level_q16_ = next;
+    
+    if (next == target) {
+        PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, false);
+    }
+}
+
+void MotorDriver::onPwmWrap(void* user_data) {
+    static_cast<MotorDriver*>(user_data)->rampStep();
 }
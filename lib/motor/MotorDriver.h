@@ -14,6 +14,30 @@
  * - Forward: IN1=HIGH, IN2=LOW
  * - Reverse: IN1=LOW, IN2=HIGH
  * - Brake: IN1=LOW, IN2=LOW or IN1=HIGH, IN2=HIGH
+ * 
+ * Brake Mode (setBrakeMode):
+ * - COAST: ENA=LOW while braking, the bridge is off and the motor freewheels
+ * - SHORT_BRAKE: ENA=HIGH while braking, the low-side switches short the
+ *   motor terminals and its back-EMF stops it quickly
+ * 
+ * Ramp Mode (setRampRate):
+ * - Duty approaches the target at a fixed slew rate instead of jumping
+ * - Steps are applied in the PWM wrap interrupt (once per PWM period), so
+ *   ramping needs no main-loop polling and changes land on period edges
+ * - The step size is computed from the slice's actual TOP and frequency;
+ *   call setRampRate() again if the slice is reconfigured
+ * - Direction changes ramp down through zero before the pins switch
+ * - The wrap IRQ is only enabled while a ramp is in progress
+ * 
+ * Current Sense (initCurrentSense):
+ * - The L298N SENSE pin (sense resistor to ground) feeds an ADC input
+ * - The ADC free-runs into its FIFO and a DMA channel copies samples into
+ *   a ring buffer; a second DMA channel restarts the first each lap, so
+ *   sampling needs no CPU at all
+ * - updateCurrent() averages the newest PWM period of samples (sized from
+ *   the slice's actual frequency, so the chopping ripple cancels) and
+ *   reports stall (high current for a while) and overcurrent (at once)
+ *   as events; either one cuts the motor immediately
  */
 
 #ifndef MOTORDRIVER_H
@@ -21,6 +45,7 @@
 
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
+#include "hardware/irq.h"
 #include <cstdint>
 
 class MotorDriver {
@@ -31,6 +56,16 @@ public:
         BRAKE
     };
     
+    enum CurrentEvent {
+        CURRENT_STALL = 0x01,      // Stall current held for the stall time
+        CURRENT_OVERLOAD = 0x02    // Overcurrent limit exceeded
+    };
+    
+    enum BrakeMode {
+        COAST,        // Bridge disabled, motor freewheels to a stop
+        SHORT_BRAKE   // Motor terminals shorted through the bridge
+    };
+    
     /**
      * @brief Constructor for L298N motor driver
      * @param in1_pin GPIO pin for IN1
@@ -65,9 +100,84 @@ public:
     
     /**
      * @brief Stop the motor (brake)
+     * In ramp mode the duty ramps down before the brake is applied.
      */
     void stop();
     
+    /**
+     * @brief Brake immediately, skipping any ramp (interrupt-safe)
+     * For limit switches and other hard stops.
+     */
+    void brakeNow();
+    
+    /**
+     * @brief Set what BRAKE does to the motor
+     * @param mode COAST or SHORT_BRAKE
+     */
+    void setBrakeMode(BrakeMode mode);
+    
+    /**
+     * @brief Start DMA sampling of the L298N current-sense output
+     * @param adc_pin ADC-capable GPIO (26-28) wired to SENSE
+     * @param sense_ohms Sense resistor in ohms
+     * @return false if no DMA channels are free
+     */
+    bool initCurrentSense(uint8_t adc_pin, float sense_ohms);
+    
+    /**
+     * @brief Set current thresholds
+     * @param overcurrent_ma Cut immediately above this (mA)
+     * @param stall_ma Stall if driven above this ...
+     * @param stall_ms ... for this long (ms)
+     */
+    void setCurrentLimits(uint16_t overcurrent_ma, uint16_t stall_ma, uint32_t stall_ms);
+    
+    /**
+     * @brief Check the latest samples for stall and overcurrent
+     * Call every few milliseconds while moving (cheap: one PWM period of
+     * samples). Stops the motor when an event is detected.
+     * @return CurrentEvent bits detected by this call (0 = none)
+     */
+    uint8_t updateCurrent();
+    
+    /**
+     * @brief Get motor current averaged over the last PWM period
+     * @return Current in mA (0 without current sense)
+     */
+    uint16_t getCurrentMa() const { return current_ma_; }
+    
+    /**
+     * @brief Get the PWM frequency the ENA slice is actually running at
+     * @return Frequency in Hz (from clk_sys, the slice divider and TOP)
+     */
+    uint32_t getPwmFrequencyHz() const;
+    
+    /**
+     * @brief Set duty slew rate for ramp mode
+     * @param percent_per_second Speed change per second (0 = instant, ramp off)
+     */
+    void setRampRate(uint16_t percent_per_second);
+    
+    /**
+     * @brief Get speed currently applied to the motor
+     * Differs from getSpeed() while a ramp is in progress.
+     * @return Applied speed (0-100)
+     */
+    uint8_t getAppliedSpeed() const;
+    
+    /**
+     * @brief Get direction currently driven on the pins
+     * Differs from getDirection() while a reversal ramps through zero.
+     * @return Applied direction
+     */
+    Direction getAppliedDirection() const { return applied_direction_; }
+    
+    /**
+     * @brief Check if a ramp is in progress
+     * @return true if the applied duty has not reached the target yet
+     */
+    bool isRamping() const { return applied_level_q16_ != target_level_q16_; }
+    
     /**
      * @brief Get current speed setting
      * @return Current speed (0-100)
@@ -100,6 +210,7 @@ private:
     uint8_t ena_pin_;
     uint8_t current_speed_;
     Direction current_direction_;
+    BrakeMode brake_mode_;
     
     uint pwm_slice_;
     uint pwm_channel_;
@@ -108,13 +219,85 @@ private:
     uint32_t move_duration_;
     bool timed_move_active_;
     
+    // Signed duty levels in Q16 (positive = FORWARD, negative = REVERSE)
+    volatile int32_t target_level_q16_;
+    volatile int32_t applied_level_q16_;
+    int32_t ramp_step_q16_;       // Change per PWM period, 0 = ramp off
+    volatile Direction applied_direction_; // Direction pins currently driven
+    
+    // Requested slice setup; timing math reads the real TOP and divider back
     static constexpr uint16_t PWM_WRAP = 999;  // 10-bit resolution
-    static constexpr float PWM_FREQ_HZ = 1000.0f;  // 1 kHz PWM frequency
+    static constexpr uint32_t PWM_FREQ_HZ = 1000;  // 1 kHz PWM frequency
+    
+    // Current sense ring (size must be a power of two for the DMA ring)
+    static constexpr uint32_t SENSE_SAMPLE_RATE_HZ = 10000;
+    static constexpr uint32_t SENSE_BUFFER_SAMPLES = 256;  // Whole periods down to ~40 Hz PWM
+    static constexpr uint32_t SENSE_RING_BITS = 9;  // log2(256 samples * 2 bytes)
+    
+    alignas(SENSE_BUFFER_SAMPLES * sizeof(uint16_t))
+    volatile uint16_t sense_buffer_[SENSE_BUFFER_SAMPLES];
+    volatile uint16_t* sense_restart_addr_;  // Read by the restart DMA channel
+    int sense_dma_channel_;                  // -1 = current sense off
+    int sense_restart_channel_;
+    float ma_per_count_;
+    uint16_t current_ma_;
+    uint16_t overcurrent_ma_;
+    uint16_t stall_ma_;
+    uint32_t stall_us_;
+    uint32_t stall_start_us_;
+    bool stall_timing_;
     
     /**
-     * @brief Update PWM duty cycle
+     * @brief Update PWM duty cycle (instantly, or by starting a ramp)
      */
     void updatePWM();
+    
+    /**
+     * @brief Stop at once with the given ENA level, skipping any ramp
+     * @param level ENA level while stopped (0 = coast)
+     */
+    void haltNow(uint16_t level);
+    
+    /**
+     * @brief Get the slice's current TOP (levels above it are always on)
+     * @return Wrap value read back from the PWM slice
+     */
+    uint16_t pwmTop() const { return (uint16_t)pwm_hw->slice[pwm_slice_].top; }
+    
+    /**
+     * @brief Get the number of sense samples in one PWM period
+     * @return Window length, limited to the ring size
+     */
+    uint32_t senseWindow() const;
+    
+    /**
+     * @brief Get ENA level used while braking
+     * @return PWM level (0 = coast, TOP + 1 = always on)
+     */
+    uint16_t brakeLevel() const {
+        if (brake_mode_ != SHORT_BRAKE) {
+            return 0;
+        }
+        uint16_t top = pwmTop();
+        return top < UINT16_MAX ? top + 1 : UINT16_MAX;  // Level is 16-bit
+    }
+    
+    /**
+     * @brief Drive the direction pins
+     * @param dir Direction
+     */
+    void writeDirection(Direction dir);
+    
+    /**
+     * @brief Advance the ramp by one PWM period (called from wrap IRQ)
+     */
+    void rampStep();
+    
+    /**
+     * @brief PWM wrap callback (see PwmWrapIrq)
+     * @param user_data MotorDriver instance
+     */
+    static void onPwmWrap(void* user_data);
 };
 
 #endif // MOTORDRIVER_H
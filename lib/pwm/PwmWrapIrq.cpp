@@ -0,0 +1,66 @@
+/**
+ * @file PwmWrapIrq.cpp
+ * @brief Implementation of shared PWM wrap interrupt dispatch
+ */
+
+#include "PwmWrapIrq.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+PwmWrapIrq::Listener PwmWrapIrq::listeners_[NUM_PWM_SLICES][LISTENERS_PER_SLICE] = {};
+bool PwmWrapIrq::irq_handler_installed_ = false;
+
+void PwmWrapIrq::attach(uint slice, uint channel, Callback callback, void* user_data) {
+    setEnabled(slice, channel, false);
+    
+    listeners_[slice][channel].callback = callback;
+    listeners_[slice][channel].user_data = user_data;
+    
+    if (!irq_handler_installed_) {
+        irq_add_shared_handler(PWM_IRQ_WRAP, pwmWrapIrqHandler,
+                               PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(PWM_IRQ_WRAP, true);
+        irq_handler_installed_ = true;
+    }
+}
+
+void PwmWrapIrq::setEnabled(uint slice, uint channel, bool enabled) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    
+    Listener* slots = listeners_[slice];
+    bool was_enabled = slots[0].enabled || slots[1].enabled || slots[2].enabled;
+    slots[channel].enabled = enabled && slots[channel].callback != nullptr;
+    bool now_enabled = slots[0].enabled || slots[1].enabled || slots[2].enabled;
+    
+    if (now_enabled && !was_enabled) {
+        // Drop a stale wrap so the first callback lands on the next period
+        pwm_clear_irq(slice);
+        pwm_set_irq_enabled(slice, true);
+    } else if (!now_enabled && was_enabled) {
+        pwm_set_irq_enabled(slice, false);
+    }
+    
+    restore_interrupts(irq_state);
+}
+
+void PwmWrapIrq::pwmWrapIrqHandler() {
+    uint32_t pending = pwm_get_irq_status_mask();
+    
+    while (pending) {
+        uint slice = __builtin_ctz(pending);
+        pending &= pending - 1;
+        
+        Listener* slots = listeners_[slice];
+        if (slots[0].callback == nullptr && slots[1].callback == nullptr &&
+            slots[2].callback == nullptr) {
+            continue;  // Leave unregistered slices to their own handlers
+        }
+        
+        pwm_clear_irq(slice);
+        for (uint i = 0; i < LISTENERS_PER_SLICE; i++) {
+            if (slots[i].enabled) {
+                slots[i].callback(slots[i].user_data);
+            }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file PwmWrapIrq.h
+ * @brief Shared PWM wrap interrupt dispatch
+ * 
+ * All PWM slices share one wrap interrupt (PWM_IRQ_WRAP). When two
+ * drivers use the two channels of the same slice (e.g. the lid servo on
+ * GPIO16 = slice 0A and the box servo on GPIO17 = slice 0B) they must
+ * not each clear the slice's flag, or one of them misses the wrap.
+ * 
+ * This dispatcher owns the handler: drivers register a callback per
+ * slice channel and enable it only while they need per-period work.
+ * Code that drives several channels at once (e.g. ServoGroup) registers
+ * on the slice itself with SLICE_LISTENER instead of a channel.
+ * The slice interrupt is enabled while any listener wants it, and each
+ * wrap is cleared once and delivered to every enabled listener.
+ * 
+ * Callbacks run in interrupt context and must be short.
+ */
+
+#ifndef PWMWRAPIRQ_H
+#define PWMWRAPIRQ_H
+
+#include "pico/stdlib.h"
+#include "hardware/pwm.h"
+#include <cstdint>
+
+class PwmWrapIrq {
+public:
+    typedef void (*Callback)(void* user_data);
+    
+    static constexpr uint SLICE_LISTENER = 2;  // Listener slot not tied to a channel
+    
+    /**
+     * @brief Register a wrap callback for one slice channel (starts disabled)
+     * @param slice PWM slice
+     * @param channel PWM_CHAN_A, PWM_CHAN_B or SLICE_LISTENER
+     * @param callback Function called once per wrap while enabled
+     * @param user_data Passed to callback
+     */
+    static void attach(uint slice, uint channel, Callback callback, void* user_data);
+    
+    /**
+     * @brief Enable or disable wrap callbacks for one slice channel (IRQ-safe)
+     * @param slice PWM slice
+     * @param channel PWM_CHAN_A, PWM_CHAN_B or SLICE_LISTENER
+     * @param enabled true to receive callbacks
+     */
+    static void setEnabled(uint slice, uint channel, bool enabled);
+    
+private:
+    struct Listener {
+        Callback callback;
+        void* user_data;
+        bool enabled;
+    };
+    
+    static constexpr uint LISTENERS_PER_SLICE = 3;  // Channel A, channel B, slice
+    
+    static Listener listeners_[NUM_PWM_SLICES][LISTENERS_PER_SLICE];
+    static bool irq_handler_installed_;
+    
+    /**
+     * @brief Shared PWM wrap interrupt handler
+     */
+    static void pwmWrapIrqHandler();
+};
+
+#endif // PWMWRAPIRQ_H
@@ -4,11 +4,75 @@
  */
 
 #include "ServoController.h"
+#include "PwmWrapIrq.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
 
-ServoController::ServoController(uint8_t pin, uint16_t min_pulse_us, uint16_t max_pulse_us)
-    : pin_(pin), min_pulse_us_(min_pulse_us), max_pulse_us_(max_pulse_us),
-      current_angle_(90.0f), target_angle_(90.0f), start_angle_(90.0f),
-      move_start_time_(0), move_duration_(0), is_moving_(false), is_attached_(false) {
+// Easing tables: EASING_TABLE_SEGMENTS + 1 points per curve, Q15 (32768 = 1.0)
+static constexpr uint32_t EASING_TABLE_BITS = 6;
+static constexpr uint32_t EASING_TABLE_SEGMENTS = 1u << EASING_TABLE_BITS;
+static constexpr int32_t Q15_ONE = 32768;
+static constexpr double PI = 3.14159265358979323846;
+
+// Taylor series (std::cos is not constexpr), accurate to ~1e-9 on [0, pi]
+static constexpr double taylorCos(double x) {
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n <= 12; n++) {
+        term *= -x * x / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+static constexpr double easeCurve(ServoController::Easing easing, double t) {
+    switch (easing) {
+        case ServoController::COSINE:
+            return (1.0 - taylorCos(PI * t)) / 2.0;
+            
+        case ServoController::MIN_JERK:
+            return t * t * t * (10.0 - 15.0 * t + 6.0 * t * t);
+            
+        case ServoController::TRAPEZOID:
+            // Accelerate for 1/3, cruise at 1.5x average speed, decelerate for 1/3
+            if (t < 1.0 / 3.0) {
+                return 2.25 * t * t;
+            } else if (t < 2.0 / 3.0) {
+                return 1.5 * t - 0.25;
+            }
+            return 1.0 - 2.25 * (1.0 - t) * (1.0 - t);
+            
+        default:
+            return t;
+    }
+}
+
+struct EasingTable {
+    uint16_t q15[EASING_TABLE_SEGMENTS + 1];
+    
+    constexpr EasingTable(ServoController::Easing easing) : q15() {
+        for (uint32_t i = 0; i <= EASING_TABLE_SEGMENTS; i++) {
+            double value = easeCurve(easing, (double)i / EASING_TABLE_SEGMENTS);
+            q15[i] = (uint16_t)(value * Q15_ONE + 0.5);
+        }
+    }
+};
+
+static constexpr EasingTable EASING_TABLES[] = {
+    EasingTable(ServoController::LINEAR),
+    EasingTable(ServoController::COSINE),
+    EasingTable(ServoController::MIN_JERK),
+    EasingTable(ServoController::TRAPEZOID)
+};
+
+ServoController::ServoController(uint8_t pin, const ServoPulseTable& pulses)
+    : pin_(pin), pulses_(&pulses),
+      current_angle_cd_(9000), target_angle_cd_(9000), start_angle_cd_(9000), easing_(MIN_JERK),
+      move_start_time_(0), move_duration_(0), is_moving_(false), is_attached_(false),
+      frame_sync_(false), speed_deg_s_(0), settle_ms_(0), model_from_cd_(9000),
+      model_target_cd_(9000), model_start_time_(0), arrival_time_(0),
+      auto_detach_ms_(0), hold_start_time_(0), holding_(false), auto_detached_(false),
+      play_buffer_(), play_dma_channel_(-1), playing_(false), play_end_angle_cd_(9000) {
 }
 
 void ServoController::init() {
@@ -17,99 +81,362 @@ void ServoController::init() {
     pwm_slice_ = pwm_gpio_to_slice_num(pin_);
     pwm_channel_ = pwm_gpio_to_channel(pin_);
     
-    // Set PWM frequency to 50 Hz (20ms period)
-    // Clock speed = 125 MHz
-    // For 50 Hz: period = 20ms = 20000µs
-    // wrap = (clock_speed / divider / frequency) - 1
-    // With divider = 64: wrap = (125000000 / 64 / 50) - 1 = 39061
-    float divider = 64.0f;
-    uint16_t wrap = 39062;  // Gives exactly 50 Hz
+    // Set PWM frequency to 50 Hz (20ms period) with a 0.5µs tick
+    // divider = clk_sys / 2 MHz, in the divider's 1/16 steps
+    // (125 MHz -> 62.5, 133 MHz -> 66.5, 266 MHz -> 133), wrap = 40000 - 1
+    // This sets the whole slice, so the other channel must be free or
+    // another servo (see the pin assignments in config.h)
+    uint32_t divider_16ths = (clock_get_hz(clk_sys) + PWM_TICK_HZ / 32) / (PWM_TICK_HZ / 16);
+    if (divider_16ths < 16) {
+        divider_16ths = 16;      // Below 2 MHz: frames run long
+    } else if (divider_16ths > 0xFFF) {
+        divider_16ths = 0xFFF;   // Above 511 MHz: frames run short
+    }
     
-    pwm_set_clkdiv(pwm_slice_, divider);
-    pwm_set_wrap(pwm_slice_, wrap);
+    pwm_set_clkdiv_int_frac(pwm_slice_, (uint8_t)(divider_16ths >> 4), (uint8_t)(divider_16ths & 0xF));
+    pwm_set_wrap(pwm_slice_, PWM_WRAP);
     
     // Set initial position to center (90 degrees)
     setAngle(90.0f);
     
     pwm_set_enabled(pwm_slice_, true);
     is_attached_ = true;
+    
+    // Register for wrap interrupts (enabled only while moving in frame-sync mode)
+    PwmWrapIrq::attach(pwm_slice_, pwm_channel_, onPwmWrap, this);
 }
 
 void ServoController::setAngle(float angle) {
-    // Clamp angle to 0-180
-    if (angle < 0.0f) angle = 0.0f;
-    if (angle > 180.0f) angle = 180.0f;
+    stopPlayback();
+    wake();
     
-    current_angle_ = angle;
-    target_angle_ = angle;
+    uint32_t irq_state = save_and_disable_interrupts();
+    current_angle_cd_ = toCentidegrees(angle);
+    target_angle_cd_ = current_angle_cd_;
     is_moving_ = false;
+    PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, false);
+    restore_interrupts(irq_state);
+    markSettled();
+    planArrival(current_angle_cd_, 0);
     
-    if (is_attached_) {
-        uint16_t pulse_us = angleToPulseWidth(angle);
-        setPulseWidth(pulse_us);
-    }
+    writeAngle(current_angle_cd_);
 }
 
 void ServoController::moveToAngle(float target_angle, uint32_t duration_ms) {
-    // Clamp angle to 0-180
-    if (target_angle < 0.0f) target_angle = 0.0f;
-    if (target_angle > 180.0f) target_angle = 180.0f;
+    // Progress is computed in 32 bits as (elapsed << 16) / duration
+    if (duration_ms > UINT16_MAX) {
+        duration_ms = UINT16_MAX;
+    }
+    
+    int32_t target_cd = toCentidegrees(target_angle);
+    stopPlayback();
+    wake();
+    
+    planArrival(target_cd, duration_ms);
     
-    start_angle_ = current_angle_;
-    target_angle_ = target_angle;
+    uint32_t irq_state = save_and_disable_interrupts();
+    start_angle_cd_ = current_angle_cd_;
+    target_angle_cd_ = target_cd;
     move_start_time_ = to_ms_since_boot(get_absolute_time());
     move_duration_ = duration_ms;
     is_moving_ = true;
+    holding_ = false;
+    PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, frame_sync_);
+    restore_interrupts(irq_state);
 }
 
-void ServoController::update() {
-    if (!is_moving_) {
+void ServoController::setFrameSync(bool enabled) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    frame_sync_ = enabled;
+    PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, enabled && is_moving_);
+    restore_interrupts(irq_state);
+}
+
+void ServoController::planMove(Trajectory& trajectory, float from_angle, float to_angle,
+                               uint32_t duration_ms) const {
+    int32_t from_cd = toCentidegrees(from_angle);
+    int32_t to_cd = toCentidegrees(to_angle);
+    
+    uint32_t frame_ms = PWM_PERIOD_US / 1000;
+    uint32_t frames = (duration_ms + frame_ms - 1) / frame_ms;
+    if (frames == 0) {
+        frames = 1;
+    } else if (frames > Trajectory::MAX_FRAMES) {
+        frames = Trajectory::MAX_FRAMES;
+    }
+    
+    // Frame i is latched at the end of frame i, so it holds the position at (i + 1) / frames
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t progress_q16 = ((i + 1) << 16) / frames;
+        int32_t eased_q15 = ease(easing_, progress_q16);
+        int32_t angle_cd = from_cd + (((to_cd - from_cd) * eased_q15) >> 15);
+        trajectory.levels[i] = angleToLevel(angle_cd);
+    }
+    
+    trajectory.frames = (uint16_t)frames;
+    trajectory.end_angle_cd = to_cd;
+}
+
+bool ServoController::play(const Trajectory& trajectory) {
+    wake();
+    if (!is_attached_ || trajectory.frames == 0 || trajectory.frames > Trajectory::MAX_FRAMES) {
+        return false;
+    }
+    
+    if (play_dma_channel_ < 0) {
+        play_dma_channel_ = dma_claim_unused_channel(false);
+        if (play_dma_channel_ < 0) {
+            return false;
+        }
+    }
+    
+    // Take over from any move in progress
+    halt();
+    
+    // XOR deltas between consecutive levels, placed in this channel's half
+    // of CC. Writing them to the XOR alias leaves the other channel intact
+    // (the SDK updates a single channel through the same alias).
+    uint32_t shift = (pwm_channel_ == PWM_CHAN_B) ? PWM_CH0_CC_B_LSB : 0;
+    uint16_t level = readLevel();
+    for (uint16_t i = 0; i < trajectory.frames; i++) {
+        play_buffer_[i] = (uint32_t)(level ^ trajectory.levels[i]) << shift;
+        level = trajectory.levels[i];
+    }
+    
+    // One word per wrap
+    dma_channel_config config = dma_channel_get_default_config(play_dma_channel_);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, pwm_get_dreq(pwm_slice_));
+    
+    // The last level is latched one frame after it is written
+    planArrival(trajectory.end_angle_cd, (trajectory.frames + 1u) * (PWM_PERIOD_US / 1000));
+    
+    play_end_angle_cd_ = trajectory.end_angle_cd;
+    playing_ = true;
+    holding_ = false;
+    dma_channel_configure(play_dma_channel_, &config, hw_xor_alias(&pwm_hw->slice[pwm_slice_].cc),
+                          play_buffer_, trajectory.frames, true);
+    
+    return true;
+}
+
+bool ServoController::isMoving() const {
+    bool commanded = playing_ ? dma_channel_is_busy(play_dma_channel_) : is_moving_;
+    if (commanded) {
+        return true;
+    }
+    
+    // Command finished: wait for the horn to catch up and settle
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    return (int32_t)(arrival_time_ - now) > 0;
+}
+
+void ServoController::setMotionModel(uint16_t speed_deg_s, uint16_t settle_ms) {
+    speed_deg_s_ = speed_deg_s;
+    settle_ms_ = settle_ms;
+}
+
+void ServoController::planArrival(int32_t target_cd, uint32_t command_ms) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    
+    // Start from where the horn is now, which may still be catching up
+    model_from_cd_ = (speed_deg_s_ > 0) ? modelAngle(now) : target_cd;
+    model_target_cd_ = target_cd;
+    model_start_time_ = now;
+    
+    if (speed_deg_s_ == 0) {
+        arrival_time_ = now + command_ms;
         return;
     }
     
+    // Arrives when both the command and the slew-limited horn have finished
+    int32_t travel_cd = target_cd - model_from_cd_;
+    if (travel_cd < 0) {
+        travel_cd = -travel_cd;
+    }
+    uint32_t slew_ms = ((uint32_t)travel_cd * 10) / speed_deg_s_;  // cd / (deg/s) = 10ms
+    
+    arrival_time_ = now + (slew_ms > command_ms ? slew_ms : command_ms) + settle_ms_;
+}
+
+int32_t ServoController::modelAngle(uint32_t now_ms) const {
+    int32_t travel_cd = model_target_cd_ - model_from_cd_;
+    uint32_t elapsed = now_ms - model_start_time_;
+    if (elapsed > UINT16_MAX) {
+        return model_target_cd_;  // Long since arrived (and avoids overflow)
+    }
+    
+    int32_t covered_cd = (int32_t)((elapsed * speed_deg_s_) / 10);
+    if (covered_cd >= (travel_cd < 0 ? -travel_cd : travel_cd)) {
+        return model_target_cd_;
+    }
+    return model_from_cd_ + (travel_cd < 0 ? -covered_cd : covered_cd);
+}
+
+float ServoController::getCurrentAngle() const {
+    if (playing_) {
+        int32_t angle_cd = dma_channel_is_busy(play_dma_channel_) ? levelToAngle(readLevel())
+                                                                  : play_end_angle_cd_;
+        return angle_cd / 100.0f;
+    }
+    return current_angle_cd_ / 100.0f;
+}
+
+int32_t ServoController::beginSyncedMove(float target_angle, uint32_t duration_ms) {
+    wake();
+    halt();
+    holding_ = false;  // Settles in endSyncedMove()
+    planArrival(toCentidegrees(target_angle), duration_ms);
+    return current_angle_cd_;
+}
+
+uint16_t ServoController::syncedLevel(int32_t angle_cd) {
+    current_angle_cd_ = angle_cd;
+    target_angle_cd_ = angle_cd;
+    return is_attached_ ? angleToLevel(angle_cd) : 0;
+}
+
+void ServoController::halt() {
+    stopPlayback();
+    
+    uint32_t irq_state = save_and_disable_interrupts();
+    is_moving_ = false;
+    target_angle_cd_ = current_angle_cd_;
+    PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, false);
+    restore_interrupts(irq_state);
+}
+
+void ServoController::stopPlayback() {
+    if (!playing_) {
+        return;
+    }
+    
+    if (dma_channel_is_busy(play_dma_channel_)) {
+        dma_channel_abort(play_dma_channel_);
+        current_angle_cd_ = levelToAngle(readLevel());
+    } else {
+        current_angle_cd_ = play_end_angle_cd_;
+    }
+    target_angle_cd_ = current_angle_cd_;
+    playing_ = false;
+    markSettled();
+}
+
+void ServoController::update() {
+    if (playing_ && !dma_channel_is_busy(play_dma_channel_)) {
+        stopPlayback();  // Finished: settle on the exact end angle
+    }
+    
+    if (holding_ && auto_detach_ms_ > 0 && !isMoving()) {
+        uint32_t held = to_ms_since_boot(get_absolute_time()) - hold_start_time_;
+        if (held >= auto_detach_ms_ && is_attached_) {
+            detach();
+            auto_detached_ = true;
+        }
+    }
+    
+    if (!is_moving_ || frame_sync_) {
+        return;  // Nothing to do, or advanced by the wrap interrupt
+    }
+    
+    step();
+}
+
+void ServoController::step() {
     uint32_t current_time = to_ms_since_boot(get_absolute_time());
     uint32_t elapsed = current_time - move_start_time_;
     
     if (elapsed >= move_duration_) {
         // Movement complete
-        setAngle(target_angle_);
+        current_angle_cd_ = target_angle_cd_;
         is_moving_ = false;
+        PwmWrapIrq::setEnabled(pwm_slice_, pwm_channel_, false);
+        markSettled();
     } else {
-        // Calculate interpolated angle using linear interpolation
-        float progress = (float)elapsed / (float)move_duration_;
-        current_angle_ = start_angle_ + (target_angle_ - start_angle_) * progress;
-        
-        if (is_attached_) {
-            uint16_t pulse_us = angleToPulseWidth(current_angle_);
-            setPulseWidth(pulse_us);
-        }
+        // Eased interpolation in fixed point
+        uint32_t progress_q16 = (elapsed << 16) / move_duration_;
+        int32_t eased_q15 = ease(easing_, progress_q16);
+        current_angle_cd_ = start_angle_cd_ +
+                            (((target_angle_cd_ - start_angle_cd_) * eased_q15) >> 15);
     }
+    
+    writeAngle(current_angle_cd_);
+}
+
+void ServoController::onPwmWrap(void* user_data) {
+    static_cast<ServoController*>(user_data)->step();
 }
 
 void ServoController::detach() {
-    pwm_set_enabled(pwm_slice_, false);
+    stopPlayback();
+    
+    // Hold the output low rather than disabling the slice, which is
+    // shared with the other channel (the other servo on slice 0)
+    uint32_t irq_state = save_and_disable_interrupts();
     is_attached_ = false;
+    holding_ = false;
+    pwm_set_chan_level(pwm_slice_, pwm_channel_, 0);
+    restore_interrupts(irq_state);
 }
 
 void ServoController::attach() {
+    auto_detached_ = false;
     if (!is_attached_) {
-        pwm_set_enabled(pwm_slice_, true);
         is_attached_ = true;
-        setAngle(current_angle_);  // Restore current position
+        writeAngle(current_angle_cd_);  // Restore current position
+        if (!is_moving_) {
+            markSettled();
+        }
+    }
+}
+
+void ServoController::wake() {
+    if (auto_detached_) {
+        attach();
+    }
+}
+
+void ServoController::markSettled() {
+    hold_start_time_ = to_ms_since_boot(get_absolute_time());
+    holding_ = true;
+}
+
+int32_t ServoController::toCentidegrees(float angle) {
+    // Clamp angle to 0-180
+    if (angle < 0.0f) angle = 0.0f;
+    if (angle > 180.0f) angle = 180.0f;
+    
+    return (int32_t)(angle * 100.0f + 0.5f);
+}
+
+int32_t ServoController::ease(Easing easing, uint32_t progress_q16) {
+    if (progress_q16 >= 65536) {
+        return Q15_ONE;
+    }
+    
+    // Table index from the top bits, interpolate on the rest
+    const uint16_t* table = EASING_TABLES[easing].q15;
+    uint32_t index = progress_q16 >> (16 - EASING_TABLE_BITS);
+    int32_t fraction = progress_q16 & ((1u << (16 - EASING_TABLE_BITS)) - 1);
+    int32_t a = table[index];
+    int32_t b = table[index + 1];
+    
+    return a + (((b - a) * fraction) >> (16 - EASING_TABLE_BITS));
+}
+
+void ServoController::writeAngle(int32_t angle_cd) {
+    if (is_attached_) {
+        setPulseWidth(angleToPulseWidth(angle_cd));
     }
 }
 
-uint16_t ServoController::angleToPulseWidth(float angle) {
-    // Map angle (0-180) to pulse width (min_pulse_us to max_pulse_us)
-    uint16_t pulse_us = min_pulse_us_ + 
-                        (uint16_t)((angle / 180.0f) * (max_pulse_us_ - min_pulse_us_));
-    return pulse_us;
+uint16_t ServoController::readLevel() const {
+    uint32_t cc = pwm_hw->slice[pwm_slice_].cc;
+    return (uint16_t)(pwm_channel_ == PWM_CHAN_B ? cc >> PWM_CH0_CC_B_LSB : cc & PWM_CH0_CC_A_BITS);
 }
 
 void ServoController::setPulseWidth(uint16_t pulse_us) {
-    // Calculate PWM level for desired pulse width
-    // wrap = 39062, which represents 20000µs
-    // level = (pulse_us * wrap) / 20000
-    uint16_t level = (pulse_us * 39062) / 20000;
-    pwm_set_chan_level(pwm_slice_, pwm_channel_, level);
+    pwm_set_chan_level(pwm_slice_, pwm_channel_, pulse_us * TICKS_PER_US);
 }
@@ -12,8 +12,48 @@
  * 
  * PWM Timing:
  * - Frequency: 50 Hz (20ms period)
- * - Pulse width: 500µs (0°) to 2500µs (180°)
- * - Typical: 1000µs (0°), 1500µs (90°), 2000µs (180°)
+ * - 0.5µs per PWM tick (TICKS_PER_US), divider derived from clk_sys at
+ *   init(); the divider stays in range for any clk_sys from 2 to 511 MHz,
+ *   overclocks included
+ * - Pulse widths come from a ServoPulseTable (per servo type or per
+ *   calibration), default 500µs (0°) to 2500µs (180°)
+ * 
+ * Smooth Motion (moveToAngle):
+ * - Angles are kept as integer centidegrees (0-18000)
+ * - Progress follows an easing curve (setEasing) read from a Q15 table
+ *   built at compile time, with linear interpolation between entries,
+ *   so update() uses integer arithmetic only
+ * - MIN_JERK (default) and COSINE start and stop at zero velocity,
+ *   TRAPEZOID accelerates/cruises/decelerates in equal thirds
+ * 
+ * Frame Sync (setFrameSync):
+ * - The servo samples its pulse once per 20ms frame, so rewriting the
+ *   level from a faster main loop is wasted work
+ * - In frame-sync mode the PWM wrap interrupt advances the trajectory
+ *   once per frame; the new level is latched by the hardware at the next
+ *   wrap, so motion stays smooth however long the main loop blocks
+ * - update() becomes a no-op and may still be called
+ * 
+ * DMA Playback (planMove + play):
+ * - A move is precomputed as one PWM compare value per frame
+ * - A DMA channel paced by the slice's wrap DREQ feeds it to the compare
+ *   register, so the whole move runs with no CPU involvement
+ * - The DMA writes to the register's XOR alias with only this channel's
+ *   half set, so the other channel of the slice (e.g. the other servo on
+ *   slice 0) is never disturbed
+ * 
+ * Auto Detach (setAutoDetach):
+ * - Once a move has settled and the hold time has passed, update() stops
+ *   the pulses so an idle servo draws no holding current and cannot jitter
+ * - The next setAngle(), moveToAngle() or play() re-attaches it
+ * - detach() drives this channel low instead of disabling the slice, so
+ *   the other channel of the slice keeps running
+ * 
+ * Arrival Model (setMotionModel):
+ * - The horn lags the command: it slews at a limited speed under load and
+ *   then needs a moment to settle
+ * - With a measured speed and settle time, isMoving() stays true until
+ *   the horn has physically arrived, and estimatedArrival() says when
  */
 
 #ifndef SERVOCONTROLLER_H
@@ -21,17 +61,36 @@
 
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
+#include "hardware/dma.h"
+#include "ServoPulseTable.h"
 #include <cstdint>
 
 class ServoController {
 public:
+    enum Easing {
+        LINEAR,      // Constant velocity (jumps to full speed)
+        COSINE,      // Half cosine: smooth start and stop
+        MIN_JERK,    // 10t^3 - 15t^4 + 6t^5: zero velocity and acceleration at the ends
+        TRAPEZOID    // Constant acceleration, cruise, constant deceleration
+    };
+    
+    /**
+     * @brief Precomputed move for play(): one PWM level per 20ms frame
+     */
+    struct Trajectory {
+        static constexpr uint16_t MAX_FRAMES = 128;  // 2.56s
+        
+        uint16_t levels[MAX_FRAMES];
+        uint16_t frames;
+        int32_t end_angle_cd;
+    };
+    
     /**
      * @brief Constructor for servo controller
      * @param pin GPIO PWM pin for servo signal
-     * @param min_pulse_us Minimum pulse width in microseconds (default 500)
-     * @param max_pulse_us Maximum pulse width in microseconds (default 2500)
+     * @param pulses Angle to pulse width table (must outlive the controller)
      */
-    ServoController(uint8_t pin, uint16_t min_pulse_us = 500, uint16_t max_pulse_us = 2500);
+    ServoController(uint8_t pin, const ServoPulseTable& pulses = SERVO_PULSES_STANDARD);
     
     /**
      * @brief Initialize servo PWM
@@ -47,10 +106,42 @@ public:
     /**
      * @brief Move servo to angle smoothly over time
      * @param target_angle Target angle in degrees (0-180)
-     * @param duration_ms Duration of movement in milliseconds
+     * @param duration_ms Duration of movement in milliseconds (max 65535)
      */
     void moveToAngle(float target_angle, uint32_t duration_ms);
     
+    /**
+     * @brief Select the easing curve used by moveToAngle()
+     * @param easing Easing curve
+     */
+    void setEasing(Easing easing) { easing_ = easing; }
+    
+    /**
+     * @brief Advance moves from the PWM wrap interrupt instead of update()
+     * @param enabled true for frame-synchronised updates
+     */
+    void setFrameSync(bool enabled);
+    
+    /**
+     * @brief Precompute an eased move (uses the current easing curve)
+     * Moves longer than MAX_FRAMES frames are sped up to fit.
+     * @param trajectory Output trajectory
+     * @param from_angle Start angle in degrees (0-180)
+     * @param to_angle End angle in degrees (0-180)
+     * @param duration_ms Duration of movement in milliseconds
+     */
+    void planMove(Trajectory& trajectory, float from_angle, float to_angle,
+                  uint32_t duration_ms) const;
+    
+    /**
+     * @brief Play a precomputed move by DMA, one level per PWM frame
+     * The trajectory is copied, so it may be reused at once.
+     * isMoving() stays true until the last level has been written.
+     * @param trajectory Trajectory from planMove()
+     * @return false if detached, the trajectory is empty or no DMA channel is free
+     */
+    bool play(const Trajectory& trajectory);
+    
     /**
      * @brief Update servo position (call in main loop for smooth motion)
      * Must be called regularly when using moveToAngle()
@@ -59,15 +150,34 @@ public:
     
     /**
      * @brief Check if servo is moving
-     * @return true if servo is currently moving to target
+     * @return true until the command has finished and the horn has arrived
      */
-    bool isMoving() const { return is_moving_; }
+    bool isMoving() const;
     
     /**
      * @brief Get current angle
      * @return Current angle in degrees
      */
-    float getCurrentAngle() const { return current_angle_; }
+    float getCurrentAngle() const;
+    
+    /**
+     * @brief Set the measured physical response used by isMoving()
+     * @param speed_deg_s Slew speed under load in degrees/second (0 = no model)
+     * @param settle_ms Time to settle after reaching the target
+     */
+    void setMotionModel(uint16_t speed_deg_s, uint16_t settle_ms);
+    
+    /**
+     * @brief Get when the horn is expected to be at rest on target
+     * @return Time in milliseconds since boot
+     */
+    uint32_t estimatedArrival() const { return arrival_time_; }
+    
+    /**
+     * @brief Stop pulses once the servo has held still for a while
+     * @param hold_ms Hold time after a move settles, or 0 to hold forever
+     */
+    void setAutoDetach(uint32_t hold_ms) { auto_detach_ms_ = hold_ms; }
     
     /**
      * @brief Detach servo (stop PWM signal)
@@ -79,32 +189,182 @@ public:
      */
     void attach();
     
+    /**
+     * @brief Hand the servo to an external timeline (e.g. ServoGroup)
+     * Stops any own move or playback, re-attaches if auto detached and
+     * starts the arrival model. Drive the move with syncedLevel() and
+     * finish it with endSyncedMove().
+     * @param target_angle End angle in degrees (0-180)
+     * @param duration_ms Duration of the external move in milliseconds
+     * @return Start angle in centidegrees
+     */
+    int32_t beginSyncedMove(float target_angle, uint32_t duration_ms);
+    
+    /**
+     * @brief Record one point of a synced move and get its PWM level
+     * The caller writes the level (possibly batched with other channels).
+     * IRQ-safe.
+     * @param angle_cd Angle in centidegrees
+     * @return PWM level for this channel (0 while detached: output held low)
+     */
+    uint16_t syncedLevel(int32_t angle_cd);
+    
+    /**
+     * @brief Finish a synced move (starts the auto-detach hold time)
+     */
+    void endSyncedMove() { markSettled(); }
+    
+    /**
+     * @brief Get the PWM slice driving this servo
+     * @return Slice number (valid after init())
+     */
+    uint getSlice() const { return pwm_slice_; }
+    
+    /**
+     * @brief Get the PWM channel driving this servo
+     * @return PWM_CHAN_A or PWM_CHAN_B (valid after init())
+     */
+    uint getChannel() const { return pwm_channel_; }
+    
+    /**
+     * @brief Convert degrees to clamped centidegrees
+     * @param angle Angle in degrees
+     * @return Angle in centidegrees (0-18000)
+     */
+    static int32_t toCentidegrees(float angle);
+    
+    /**
+     * @brief Evaluate an easing curve
+     * @param easing Easing curve
+     * @param progress_q16 Time progress in Q16 (0-65536)
+     * @return Position progress in Q15 (0-32768)
+     */
+    static int32_t ease(Easing easing, uint32_t progress_q16);
+    
+    static constexpr uint32_t PWM_PERIOD_US = 20000;  // 20ms period (one servo frame)
+    
 private:
     uint8_t pin_;
-    uint16_t min_pulse_us_;
-    uint16_t max_pulse_us_;
+    const ServoPulseTable* pulses_;
     
-    float current_angle_;
-    float target_angle_;
-    float start_angle_;
+    // Angles in centidegrees
+    volatile int32_t current_angle_cd_;
+    int32_t target_angle_cd_;
+    int32_t start_angle_cd_;
+    Easing easing_;
     
     uint32_t move_start_time_;
     uint32_t move_duration_;
-    bool is_moving_;
+    volatile bool is_moving_;
     bool is_attached_;
+    bool frame_sync_;
+    
+    // Arrival model (horn slews toward model_target_cd_ from model_from_cd_)
+    uint16_t speed_deg_s_;        // 0 = no model
+    uint16_t settle_ms_;
+    int32_t model_from_cd_;
+    int32_t model_target_cd_;
+    uint32_t model_start_time_;
+    uint32_t arrival_time_;
+    
+    // Auto detach
+    uint32_t auto_detach_ms_;     // 0 = off
+    uint32_t hold_start_time_;
+    volatile bool holding_;       // Settled, waiting for the hold time
+    bool auto_detached_;
+    
+    // DMA playback
+    uint32_t play_buffer_[Trajectory::MAX_FRAMES];  // XOR deltas for the CC register
+    int play_dma_channel_;                          // -1 until the first play()
+    bool playing_;
+    int32_t play_end_angle_cd_;
     
     uint pwm_slice_;
     uint pwm_channel_;
     
     static constexpr uint16_t PWM_FREQUENCY = 50;  // 50 Hz for servo
-    static constexpr uint32_t PWM_PERIOD_US = 20000;  // 20ms period
+    static constexpr uint32_t PWM_TICK_HZ = 2000000;  // 0.5µs per tick
+    static constexpr uint16_t TICKS_PER_US = PWM_TICK_HZ / 1000000;
+    static constexpr uint16_t PWM_WRAP = PWM_PERIOD_US * TICKS_PER_US - 1;
     
     /**
-     * @brief Convert angle to pulse width
-     * @param angle Angle in degrees (0-180)
+     * @brief Advance the current move and output the new angle
+     */
+    void step();
+    
+    /**
+     * @brief Restart the arrival model for a new command
+     * @param target_cd Commanded end angle in centidegrees
+     * @param command_ms Time until the command reaches target_cd
+     */
+    void planArrival(int32_t target_cd, uint32_t command_ms);
+    
+    /**
+     * @brief Estimate the physical horn angle
+     * @param now_ms Time in milliseconds since boot
+     * @return Angle in centidegrees
+     */
+    int32_t modelAngle(uint32_t now_ms) const;
+    
+    /**
+     * @brief Re-attach if auto detached (before a new move)
+     */
+    void wake();
+    
+    /**
+     * @brief Start the auto-detach hold time (a move has settled)
+     */
+    void markSettled();
+    
+    /**
+     * @brief Stop any move or playback in progress, keeping the angle reached
+     */
+    void halt();
+    
+    /**
+     * @brief End DMA playback (aborting it if still running)
+     * Leaves current_angle_cd_ at the angle actually reached.
+     */
+    void stopPlayback();
+    
+    /**
+     * @brief Read this channel's level from the compare register
+     * @return PWM level
+     */
+    uint16_t readLevel() const;
+    
+    /**
+     * @brief Convert a PWM level back to an angle
+     * @param level PWM level (TICKS_PER_US per µs of pulse width)
+     * @return Angle in centidegrees (0-18000)
+     */
+    int32_t levelToAngle(uint16_t level) const { return pulses_->angleFor(level / TICKS_PER_US); }
+    
+    /**
+     * @brief PWM wrap callback (see PwmWrapIrq)
+     * @param user_data ServoController instance
+     */
+    static void onPwmWrap(void* user_data);
+    
+    /**
+     * @brief Output an angle (if attached)
+     * @param angle_cd Angle in centidegrees
+     */
+    void writeAngle(int32_t angle_cd);
+    
+    /**
+     * @brief Convert angle to pulse width (table lookup)
+     * @param angle_cd Angle in centidegrees (0-18000)
      * @return Pulse width in microseconds
      */
-    uint16_t angleToPulseWidth(float angle);
+    uint16_t angleToPulseWidth(int32_t angle_cd) const { return pulses_->pulseFor(angle_cd); }
+    
+    /**
+     * @brief Convert angle to PWM level
+     * @param angle_cd Angle in centidegrees (0-18000)
+     * @return PWM level
+     */
+    uint16_t angleToLevel(int32_t angle_cd) const { return angleToPulseWidth(angle_cd) * TICKS_PER_US; }
     
     /**
      * @brief Set PWM pulse width
@@ -0,0 +1,146 @@
+/**
+ * @file ServoGroup.cpp
+ * @brief Implementation of coordinated multi-servo motion
+ */
+
+#include "ServoGroup.h"
+#include "PwmWrapIrq.h"
+#include "hardware/sync.h"
+
+ServoGroup::ServoGroup()
+    : servos_(), start_angle_cd_(), target_angle_cd_(), count_(0),
+      easing_(ServoController::MIN_JERK),
+      move_start_time_(0), move_duration_(0), last_frame_us_(0), is_moving_(false),
+      frame_sync_(false), sync_slice_(0) {
+}
+
+bool ServoGroup::add(ServoController& servo) {
+    if (count_ >= MAX_SERVOS) {
+        return false;
+    }
+    
+    servos_[count_++] = &servo;
+    return true;
+}
+
+void ServoGroup::setFrameSync(bool enabled) {
+    if (count_ == 0) {
+        return;
+    }
+    
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (frame_sync_) {
+        PwmWrapIrq::setEnabled(sync_slice_, PwmWrapIrq::SLICE_LISTENER, false);
+    }
+    frame_sync_ = enabled;
+    if (enabled) {
+        sync_slice_ = servos_[0]->getSlice();
+        PwmWrapIrq::attach(sync_slice_, PwmWrapIrq::SLICE_LISTENER, onPwmWrap, this);
+        PwmWrapIrq::setEnabled(sync_slice_, PwmWrapIrq::SLICE_LISTENER, is_moving_);
+    }
+    restore_interrupts(irq_state);
+}
+
+void ServoGroup::moveTo(const float* angles, uint32_t duration_ms) {
+    if (duration_ms > UINT16_MAX) {
+        duration_ms = UINT16_MAX;
+    }
+    
+    // Stop a group move in progress before handing the servos over
+    uint32_t irq_state = save_and_disable_interrupts();
+    is_moving_ = false;
+    if (frame_sync_) {
+        PwmWrapIrq::setEnabled(sync_slice_, PwmWrapIrq::SLICE_LISTENER, false);
+    }
+    restore_interrupts(irq_state);
+    
+    for (uint8_t i = 0; i < count_; i++) {
+        start_angle_cd_[i] = servos_[i]->beginSyncedMove(angles[i], duration_ms);
+        target_angle_cd_[i] = ServoController::toCentidegrees(angles[i]);
+    }
+    
+    irq_state = save_and_disable_interrupts();
+    move_start_time_ = to_ms_since_boot(get_absolute_time());
+    move_duration_ = duration_ms;
+    last_frame_us_ = time_us_32() - ServoController::PWM_PERIOD_US;  // First frame now
+    is_moving_ = true;
+    if (frame_sync_) {
+        PwmWrapIrq::setEnabled(sync_slice_, PwmWrapIrq::SLICE_LISTENER, true);
+    }
+    restore_interrupts(irq_state);
+}
+
+void ServoGroup::update() {
+    if (is_moving_ && !frame_sync_) {
+        uint32_t now_us = time_us_32();
+        
+        // The servos only sample once per frame
+        if ((now_us - last_frame_us_) >= ServoController::PWM_PERIOD_US) {
+            last_frame_us_ = now_us;
+            step();
+        }
+    }
+    
+    for (uint8_t i = 0; i < count_; i++) {
+        servos_[i]->update();
+    }
+}
+
+void ServoGroup::step() {
+    uint32_t elapsed = to_ms_since_boot(get_absolute_time()) - move_start_time_;
+    if (elapsed >= move_duration_) {
+        writeFrame(32768);
+        is_moving_ = false;
+        if (frame_sync_) {
+            PwmWrapIrq::setEnabled(sync_slice_, PwmWrapIrq::SLICE_LISTENER, false);
+        }
+        for (uint8_t i = 0; i < count_; i++) {
+            servos_[i]->endSyncedMove();
+        }
+    } else {
+        uint32_t progress_q16 = (elapsed << 16) / move_duration_;
+        writeFrame(ServoController::ease(easing_, progress_q16));
+    }
+}
+
+void ServoGroup::onPwmWrap(void* user_data) {
+    static_cast<ServoGroup*>(user_data)->step();
+}
+
+bool ServoGroup::isMoving() const {
+    if (is_moving_) {
+        return true;
+    }
+    
+    for (uint8_t i = 0; i < count_; i++) {
+        if (servos_[i]->isMoving()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ServoGroup::writeFrame(int32_t eased_q15) {
+    uint32_t cc_values[NUM_PWM_SLICES] = {0};
+    uint32_t cc_masks[NUM_PWM_SLICES] = {0};
+    
+    for (uint8_t i = 0; i < count_; i++) {
+        ServoController* servo = servos_[i];
+        int32_t angle_cd = start_angle_cd_[i] +
+                           (((target_angle_cd_[i] - start_angle_cd_[i]) * eased_q15) >> 15);
+        uint16_t level = servo->syncedLevel(angle_cd);
+        
+        // A detached servo reports level 0, which keeps its output low
+        uint slice = servo->getSlice();
+        uint32_t shift = (servo->getChannel() == PWM_CHAN_B) ? PWM_CH0_CC_B_LSB : 0;
+        cc_values[slice] |= (uint32_t)level << shift;
+        cc_masks[slice] |= (uint32_t)PWM_CH0_CC_A_BITS << shift;
+    }
+    
+    // One write per slice; other channels keep their level
+    for (uint slice = 0; slice < NUM_PWM_SLICES; slice++) {
+        if (cc_masks[slice] != 0) {
+            hw_write_masked(&pwm_hw->slice[slice].cc, cc_values[slice], cc_masks[slice]);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * @file ServoGroup.h
+ * @brief Coordinated motion of several servos on one timeline
+ * 
+ * A group move starts every member at the same instant and finishes them
+ * together. The easing curve is evaluated once per frame for the whole
+ * group, each servo only scales it by its own travel, and all levels are
+ * written in one batch: one masked compare-register write per PWM slice
+ * (servos on the two channels of a slice share a write; channels outside
+ * the group, such as the motor ENA, are left alone).
+ * 
+ * update() also updates each member, so individual moves and DMA
+ * playback keep working; call it in place of the per-servo update()s.
+ * 
+ * With frame sync (setFrameSync) the group move is advanced from the
+ * first member's PWM wrap interrupt instead of update(), so each frame
+ * is written right after a period starts, whatever the main loop does.
+ */
+
+#ifndef SERVOGROUP_H
+#define SERVOGROUP_H
+
+#include "pico/stdlib.h"
+#include "ServoController.h"
+#include <cstdint>
+
+class ServoGroup {
+public:
+    static constexpr uint8_t MAX_SERVOS = 4;
+    
+    ServoGroup();
+    
+    /**
+     * @brief Add a servo (must already be initialized)
+     * @param servo Servo to add
+     * @return false if the group is full
+     */
+    bool add(ServoController& servo);
+    
+    /**
+     * @brief Select the easing curve used by moveTo()
+     * @param easing Easing curve
+     */
+    void setEasing(ServoController::Easing easing) { easing_ = easing; }
+    
+    /**
+     * @brief Advance group moves from the PWM wrap interrupt
+     * Call after add(); uses the first member's PWM slice, so members
+     * should share it (or run at the same frame rate).
+     * @param enabled true for wrap-driven frames, false for update()
+     */
+    void setFrameSync(bool enabled);
+    
+    /**
+     * @brief Move all servos together, starting and finishing in sync
+     * Takes over from any individual move in progress.
+     * @param angles Target angle in degrees for each servo, in add() order
+     * @param duration_ms Duration of movement in milliseconds (max 65535)
+     */
+    void moveTo(const float* angles, uint32_t duration_ms);
+    
+    /**
+     * @brief Advance the group move and member servos (call in main loop)
+     * The group move is recomputed at most once per PWM frame (by the
+     * wrap interrupt instead when frame sync is on).
+     */
+    void update();
+    
+    /**
+     * @brief Check if the group or any member is moving
+     * @return true while any servo is moving
+     */
+    bool isMoving() const;
+    
+private:
+    ServoController* servos_[MAX_SERVOS];
+    int32_t start_angle_cd_[MAX_SERVOS];
+    int32_t target_angle_cd_[MAX_SERVOS];
+    uint8_t count_;
+    ServoController::Easing easing_;
+    
+    uint32_t move_start_time_;
+    uint32_t move_duration_;
+    uint32_t last_frame_us_;
+    volatile bool is_moving_;
+    bool frame_sync_;
+    uint sync_slice_;
+    
+    /**
+     * @brief Compute and write one frame, finishing the move at the end
+     */
+    void step();
+    
+    /**
+     * @brief PWM wrap callback (see PwmWrapIrq)
+     * @param user_data ServoGroup instance
+     */
+    static void onPwmWrap(void* user_data);
+    
+    /**
+     * @brief Output the group at one point of the shared easing curve
+     * @param eased_q15 Position progress in Q15 (0-32768)
+     */
+    void writeFrame(int32_t eased_q15);
+};
+
+#endif // SERVOGROUP_H
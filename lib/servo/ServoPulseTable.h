@@ -0,0 +1,95 @@
+/**
+ * @file ServoPulseTable.h
+ * @brief Compile-time angle to pulse width tables for hobby servos
+ * 
+ * Servos differ in the pulse widths that reach 0°, 90° and 180°, and
+ * many are not linear across the range. A table is built at compile time
+ * from three measured pulse widths (piecewise linear through 90°) with
+ * one entry per degree; lookups interpolate between entries in integer
+ * math.
+ * 
+ * Entries are pulse widths in µs; ServoController scales them to its PWM
+ * tick when writing the compare level.
+ * 
+ * Usage:
+ *   constexpr ServoPulseTable gatePulses(540, 1480, 2430);
+ *   ServoController gate(SERVO_BOX_PIN, gatePulses);
+ */
+
+#ifndef SERVOPULSETABLE_H
+#define SERVOPULSETABLE_H
+
+#include <cstdint>
+
+class ServoPulseTable {
+public:
+    static constexpr uint16_t ENTRIES = 181;  // One per degree, 0-180
+    
+    /**
+     * @brief Build a table from measured pulse widths (monotonic)
+     * @param pulse_0_us Pulse width at 0°
+     * @param pulse_90_us Pulse width at 90°
+     * @param pulse_180_us Pulse width at 180°
+     */
+    constexpr ServoPulseTable(uint16_t pulse_0_us, uint16_t pulse_90_us, uint16_t pulse_180_us)
+        : pulse_us_() {
+        for (uint16_t deg = 0; deg < ENTRIES; deg++) {
+            int32_t from = (deg <= 90) ? pulse_0_us : pulse_90_us;
+            int32_t to = (deg <= 90) ? pulse_90_us : pulse_180_us;
+            int32_t delta = (to - from) * ((deg <= 90) ? deg : deg - 90);
+            pulse_us_[deg] = (uint16_t)(from + (delta + (delta >= 0 ? 45 : -45)) / 90);
+        }
+    }
+    
+    /**
+     * @brief Get the pulse width for an angle
+     * @param angle_cd Angle in centidegrees (clamped to 0-18000)
+     * @return Pulse width in microseconds
+     */
+    constexpr uint16_t pulseFor(int32_t angle_cd) const {
+        if (angle_cd <= 0) {
+            return pulse_us_[0];
+        }
+        if (angle_cd >= 18000) {
+            return pulse_us_[ENTRIES - 1];
+        }
+        
+        int32_t deg = angle_cd / 100;
+        int32_t a = pulse_us_[deg];
+        int32_t b = pulse_us_[deg + 1];
+        return (uint16_t)(a + ((b - a) * (angle_cd % 100)) / 100);
+    }
+    
+    /**
+     * @brief Get the angle for a pulse width (inverse of pulseFor)
+     * @param pulse_us Pulse width in microseconds
+     * @return Angle in centidegrees (0-18000)
+     */
+    constexpr int32_t angleFor(uint16_t pulse_us) const {
+        bool rising = pulse_us_[ENTRIES - 1] >= pulse_us_[0];
+        
+        for (int32_t deg = 0; deg < ENTRIES - 1; deg++) {
+            int32_t a = pulse_us_[deg];
+            int32_t b = pulse_us_[deg + 1];
+            if (rising ? (pulse_us <= b) : (pulse_us >= b)) {
+                if (a == b) {
+                    return deg * 100;
+                }
+                int32_t frac = ((pulse_us - a) * 100) / (b - a);
+                if (frac < 0) frac = 0;
+                if (frac > 100) frac = 100;
+                return deg * 100 + frac;
+            }
+        }
+        return 18000;
+    }
+    
+private:
+    uint16_t pulse_us_[ENTRIES];
+};
+
+// Common servo types
+inline constexpr ServoPulseTable SERVO_PULSES_STANDARD(500, 1500, 2500);  // Full 180° range
+inline constexpr ServoPulseTable SERVO_PULSES_NARROW(1000, 1500, 2000);   // Classic 1-2ms servos
+
+#endif // SERVOPULSETABLE_H
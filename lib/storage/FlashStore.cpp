@@ -0,0 +1,90 @@
+/**
+ * @file FlashStore.cpp
+ * @brief Implementation of versioned flash record storage
+ */
+
+#include "FlashStore.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include <cstring>
+
+FlashStore::FlashStore(uint8_t sector_from_end)
+    : flash_offset_(PICO_FLASH_SIZE_BYTES - (sector_from_end + 1u) * FLASH_SECTOR_SIZE) {
+}
+
+bool FlashStore::load(uint32_t magic, uint16_t version, void* data, uint16_t size) const {
+    // Flash is memory-mapped through XIP
+    const uint8_t* flash = (const uint8_t*)(XIP_BASE + flash_offset_);
+    
+    Header header;
+    memcpy(&header, flash, sizeof(header));
+    
+    if (header.magic != magic || header.version != version || header.size != size) {
+        return false;  // Missing, different type, or older layout
+    }
+    
+    const uint8_t* payload = flash + sizeof(header);
+    if (crc32(payload, size) != header.crc) {
+        return false;  // Corrupted
+    }
+    
+    memcpy(data, payload, size);
+    return true;
+}
+
+bool FlashStore::save(uint32_t magic, uint16_t version, const void* data, uint16_t size) {
+    if (sizeof(Header) + size > FLASH_SECTOR_SIZE) {
+        return false;
+    }
+    
+    Header header;
+    header.magic = magic;
+    header.version = version;
+    header.size = size;
+    header.crc = crc32((const uint8_t*)data, size);
+    
+    erase();
+    
+    // Program page by page (flash writes must be whole pages)
+    const uint8_t* src = (const uint8_t*)data;
+    uint32_t total = sizeof(header) + size;
+    uint8_t page[FLASH_PAGE_SIZE];
+    
+    for (uint32_t offset = 0; offset < total; offset += FLASH_PAGE_SIZE) {
+        memset(page, 0xFF, sizeof(page));
+        
+        for (uint32_t i = 0; i < FLASH_PAGE_SIZE && offset + i < total; i++) {
+            uint32_t pos = offset + i;
+            page[i] = (pos < sizeof(header)) ? ((const uint8_t*)&header)[pos]
+                                             : src[pos - sizeof(header)];
+        }
+        
+        uint32_t irq_state = save_and_disable_interrupts();
+        flash_range_program(flash_offset_ + offset, page, FLASH_PAGE_SIZE);
+        restore_interrupts(irq_state);
+    }
+    
+    // Read back to verify
+    const uint8_t* flash = (const uint8_t*)(XIP_BASE + flash_offset_);
+    return memcmp(flash, &header, sizeof(header)) == 0 &&
+           memcmp(flash + sizeof(header), data, size) == 0;
+}
+
+void FlashStore::erase() {
+    uint32_t irq_state = save_and_disable_interrupts();
+    flash_range_erase(flash_offset_, FLASH_SECTOR_SIZE);
+    restore_interrupts(irq_state);
+}
+
+uint32_t FlashStore::crc32(const uint8_t* data, uint32_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    
+    for (uint32_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1u)));
+        }
+    }
+    
+    return ~crc;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file FlashStore.h
+ * @brief Versioned record storage in an on-board flash sector
+ * 
+ * Stores one record per 4KB flash sector, counted back from the end of
+ * flash so it never overlaps the program image. Each record carries a
+ * magic number, a version and a CRC32, so stale or corrupted data from
+ * an older firmware is rejected on load.
+ * 
+ * Record Layout:
+ * - Header: magic (4), version (2), size (2), crc32 (4)
+ * - Payload: size bytes
+ * 
+ * Note: save() disables interrupts while the flash is erased and
+ * programmed (a few tens of ms). Only call it from the main loop when
+ * nothing time-critical is running.
+ */
+
+#ifndef FLASHSTORE_H
+#define FLASHSTORE_H
+
+#include "pico/stdlib.h"
+#include <cstdint>
+
+class FlashStore {
+public:
+    /**
+     * @brief Constructor for flash record store
+     * @param sector_from_end Sector index counted back from the end of flash (0 = last)
+     */
+    FlashStore(uint8_t sector_from_end);
+    
+    /**
+     * @brief Load a record
+     * @param magic Expected magic number
+     * @param version Expected record version
+     * @param data Destination buffer
+     * @param size Expected payload size in bytes
+     * @return true if a matching, intact record was copied into data
+     */
+    bool load(uint32_t magic, uint16_t version, void* data, uint16_t size) const;
+    
+    /**
+     * @brief Save a record (erases the sector first)
+     * @param magic Magic number identifying the record type
+     * @param version Record version
+     * @param data Payload
+     * @param size Payload size in bytes
+     * @return true if the record was written and verified
+     */
+    bool save(uint32_t magic, uint16_t version, const void* data, uint16_t size);
+    
+    /**
+     * @brief Erase the sector (invalidates the stored record)
+     */
+    void erase();
+    
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t size;
+        uint32_t crc;
+    };
+    
+    uint32_t flash_offset_;
+    
+    /**
+     * @brief Compute CRC32 (IEEE 802.3) of a buffer
+     * @param data Buffer
+     * @param size Buffer size in bytes
+     * @return CRC32
+     */
+    static uint32_t crc32(const uint8_t* data, uint32_t size);
+};
+
+#endif // FLASHSTORE_H
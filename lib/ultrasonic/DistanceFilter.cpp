@@ -0,0 +1,77 @@
+/**
+ * @file DistanceFilter.cpp
+ * @brief Implementation of non-template distance filter stages
+ */
+
+#include "DistanceFilter.h"
+
+// ============================================================================
+// OutlierRejector
+// ============================================================================
+
+OutlierRejector::OutlierRejector(float max_jump_cm, uint8_t max_rejections)
+    : max_jump_cm_(max_jump_cm), max_rejections_(max_rejections),
+      rejections_(0), relocked_(false) {
+}
+
+bool OutlierRejector::accept(float sample_cm, float predicted_cm) {
+    float error = sample_cm - predicted_cm;
+    if (error < 0.0f) {
+        error = -error;
+    }
+    
+    relocked_ = false;
+    
+    if (error <= max_jump_cm_) {
+        rejections_ = 0;
+        return true;
+    }
+    
+    rejections_++;
+    if (rejections_ > max_rejections_) {
+        // Too many in a row: the position really changed
+        rejections_ = 0;
+        relocked_ = true;
+        return true;
+    }
+    
+    return false;
+}
+
+void OutlierRejector::reset() {
+    rejections_ = 0;
+    relocked_ = false;
+}
+
+// ============================================================================
+// AlphaBetaFilter
+// ============================================================================
+
+AlphaBetaFilter::AlphaBetaFilter(float alpha, float beta)
+    : alpha_(alpha), beta_(beta), position_cm_(0.0f), velocity_cm_s_(0.0f) {
+}
+
+void AlphaBetaFilter::reset(float position_cm) {
+    position_cm_ = position_cm;
+    velocity_cm_s_ = 0.0f;
+}
+
+float AlphaBetaFilter::predict(float dt_s) const {
+    return position_cm_ + velocity_cm_s_ * dt_s;
+}
+
+float AlphaBetaFilter::update(float measured_cm, float dt_s) {
+    float predicted = predict(dt_s);
+    float residual = measured_cm - predicted;
+    
+    position_cm_ = predicted + alpha_ * residual;
+    if (dt_s > 0.0f) {
+        velocity_cm_s_ += (beta_ / dt_s) * residual;
+    }
+    
+    return residual;
+}
+
+void AlphaBetaFilter::coast(float dt_s) {
+    position_cm_ = predict(dt_s);
+}
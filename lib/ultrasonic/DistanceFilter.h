@@ -0,0 +1,304 @@
+/**
+ * @file DistanceFilter.h
+ * @brief Streaming distance filter pipeline for ultrasonic readings
+ * 
+ * Allocation-free filter stages that can be used on their own or
+ * composed through DistanceFilter:
+ * - MedianFilter<N>: removes single-sample spikes (multipath, crosstalk)
+ * - OutlierRejector: gates samples against the predicted position
+ * - AlphaBetaFilter: tracks position and velocity (steady-state Kalman)
+ * 
+ * Pipeline (DistanceFilter):
+ *   raw sample -> median-of-N -> outlier gate -> alpha-beta -> estimate
+ * 
+ * Every sample (including failed measurements) produces an estimate with
+ * position, velocity and a confidence value in the range 0.0 - 1.0.
+ */
+
+#ifndef DISTANCEFILTER_H
+#define DISTANCEFILTER_H
+
+#include <cstdint>
+
+/**
+ * @brief Filtered distance estimate
+ */
+struct DistanceEstimate {
+    float position_cm;    // Filtered distance in cm
+    float velocity_cm_s;  // Rate of change in cm/s (positive = moving away)
+    float confidence;     // 0.0 (no trust) to 1.0 (consistent samples)
+    bool valid;           // false until the filter has locked on
+};
+
+/**
+ * @brief Running median over the last N samples
+ * @tparam N Window size (odd values recommended)
+ */
+template <uint8_t N>
+class MedianFilter {
+public:
+    MedianFilter() : count_(0), index_(0) {}
+    
+    /**
+     * @brief Add a sample and return the median of the window
+     * @param sample New sample
+     * @return Median of up to the last N samples
+     */
+    float update(float sample) {
+        window_[index_] = sample;
+        index_ = (index_ + 1) % N;
+        if (count_ < N) {
+            count_++;
+        }
+        
+        // Insertion sort a copy (N is small)
+        float sorted[N];
+        for (uint8_t i = 0; i < count_; i++) {
+            float value = window_[i];
+            uint8_t j = i;
+            while (j > 0 && sorted[j - 1] > value) {
+                sorted[j] = sorted[j - 1];
+                j--;
+            }
+            sorted[j] = value;
+        }
+        
+        return sorted[count_ / 2];
+    }
+    
+    /**
+     * @brief Clear the window
+     */
+    void reset() {
+        count_ = 0;
+        index_ = 0;
+    }
+    
+private:
+    float window_[N];
+    uint8_t count_;
+    uint8_t index_;
+};
+
+/**
+ * @brief Rejects samples too far from the predicted value
+ */
+class OutlierRejector {
+public:
+    /**
+     * @brief Constructor for outlier gate
+     * @param max_jump_cm Largest accepted distance from the prediction
+     * @param max_rejections Consecutive rejections before re-locking
+     */
+    OutlierRejector(float max_jump_cm, uint8_t max_rejections);
+    
+    /**
+     * @brief Check a sample against the prediction
+     * After max_rejections rejections in a row the sample is accepted,
+     * so the filter can follow a real jump in position.
+     * @param sample_cm Measured distance
+     * @param predicted_cm Predicted distance
+     * @return true if the sample should be used
+     */
+    bool accept(float sample_cm, float predicted_cm);
+    
+    /**
+     * @brief Check if the last accept() call was a forced re-lock
+     * @return true if the gate gave up and accepted an outlier
+     */
+    bool relocked() const { return relocked_; }
+    
+    /**
+     * @brief Get the gate width
+     * @return Maximum accepted jump in cm
+     */
+    float getMaxJump() const { return max_jump_cm_; }
+    
+    /**
+     * @brief Reset rejection counter
+     */
+    void reset();
+    
+private:
+    float max_jump_cm_;
+    uint8_t max_rejections_;
+    uint8_t rejections_;
+    bool relocked_;
+};
+
+/**
+ * @brief Alpha-beta position/velocity tracker
+ */
+class AlphaBetaFilter {
+public:
+    /**
+     * @brief Constructor for alpha-beta filter
+     * @param alpha Position correction gain (0-1)
+     * @param beta Velocity correction gain (0-2, typically alpha^2 / (2 - alpha))
+     */
+    AlphaBetaFilter(float alpha, float beta);
+    
+    /**
+     * @brief Reset state to a known position at rest
+     * @param position_cm Initial position
+     */
+    void reset(float position_cm);
+    
+    /**
+     * @brief Predicted position after dt without correcting
+     * @param dt_s Time since last update in seconds
+     * @return Predicted position in cm
+     */
+    float predict(float dt_s) const;
+    
+    /**
+     * @brief Advance by dt and correct with a measurement
+     * @param measured_cm Measured position
+     * @param dt_s Time since last update in seconds
+     * @return Residual (measured - predicted) in cm
+     */
+    float update(float measured_cm, float dt_s);
+    
+    /**
+     * @brief Advance by dt without a measurement (coast)
+     * @param dt_s Time since last update in seconds
+     */
+    void coast(float dt_s);
+    
+    float getPosition() const { return position_cm_; }
+    float getVelocity() const { return velocity_cm_s_; }
+    
+private:
+    float alpha_;
+    float beta_;
+    float position_cm_;
+    float velocity_cm_s_;
+};
+
+/**
+ * @brief Complete distance filter pipeline
+ * @tparam MEDIAN_N Median window size
+ */
+template <uint8_t MEDIAN_N = 3>
+class DistanceFilter {
+public:
+    /**
+     * @brief Constructor for distance filter pipeline
+     * @param alpha Alpha-beta position gain
+     * @param beta Alpha-beta velocity gain
+     * @param max_jump_cm Outlier gate width in cm
+     * @param max_rejections Consecutive outliers before re-locking
+     */
+    DistanceFilter(float alpha = 0.5f, float beta = 0.2f,
+                   float max_jump_cm = 2.0f, uint8_t max_rejections = 3)
+        : gate_(max_jump_cm, max_rejections), tracker_(alpha, beta),
+          estimate_{0.0f, 0.0f, 0.0f, false}, last_time_us_(0), has_time_(false) {}
+    
+    /**
+     * @brief Feed one measurement through the pipeline
+     * @param sample_cm Measured distance, negative if the measurement failed
+     * @param timestamp_us Time of the measurement in microseconds
+     * @return Updated estimate
+     */
+    const DistanceEstimate& update(float sample_cm, uint32_t timestamp_us) {
+        float dt_s = has_time_ ? (timestamp_us - last_time_us_) * 1e-6f : 0.0f;
+        last_time_us_ = timestamp_us;
+        has_time_ = true;
+        
+        if (sample_cm < 0.0f) {
+            // Failed measurement: coast and lose confidence
+            if (estimate_.valid) {
+                tracker_.coast(dt_s);
+                publish();
+            }
+            estimate_.confidence *= CONFIDENCE_DECAY;
+            return estimate_;
+        }
+        
+        float median = median_.update(sample_cm);
+        
+        if (!estimate_.valid) {
+            // First sample: lock on
+            tracker_.reset(median);
+            estimate_.valid = true;
+            estimate_.confidence = CONFIDENCE_INITIAL;
+            publish();
+            return estimate_;
+        }
+        
+        if (!gate_.accept(median, tracker_.predict(dt_s))) {
+            tracker_.coast(dt_s);
+            estimate_.confidence *= CONFIDENCE_DECAY;
+            publish();
+            return estimate_;
+        }
+        
+        if (gate_.relocked()) {
+            // Position really jumped: restart tracking there
+            median_.reset();
+            median_.update(sample_cm);
+            tracker_.reset(sample_cm);
+            estimate_.confidence = CONFIDENCE_INITIAL;
+            publish();
+            return estimate_;
+        }
+        
+        float residual = tracker_.update(median, dt_s);
+        if (residual < 0.0f) {
+            residual = -residual;
+        }
+        
+        // Confidence follows how well samples agree with the prediction
+        float quality = 1.0f - residual / gate_.getMaxJump();
+        estimate_.confidence = estimate_.confidence * CONFIDENCE_DECAY +
+                               quality * (1.0f - CONFIDENCE_DECAY);
+        publish();
+        return estimate_;
+    }
+    
+    /**
+     * @brief Get the latest estimate
+     * @return Current estimate
+     */
+    const DistanceEstimate& getEstimate() const { return estimate_; }
+    
+    /**
+     * @brief Forget all history
+     */
+    void reset() {
+        median_.reset();
+        gate_.reset();
+        estimate_ = {0.0f, 0.0f, 0.0f, false};
+        has_time_ = false;
+    }
+    
+    /**
+     * @brief Reset to a known position (e.g. last settled position)
+     * @param position_cm Known position
+     */
+    void reset(float position_cm) {
+        reset();
+        tracker_.reset(position_cm);
+        estimate_.valid = true;
+        estimate_.confidence = CONFIDENCE_INITIAL;
+        publish();
+    }
+    
+private:
+    MedianFilter<MEDIAN_N> median_;
+    OutlierRejector gate_;
+    AlphaBetaFilter tracker_;
+    DistanceEstimate estimate_;
+    uint32_t last_time_us_;
+    bool has_time_;
+    
+    static constexpr float CONFIDENCE_INITIAL = 0.5f;
+    static constexpr float CONFIDENCE_DECAY = 0.7f;
+    
+    void publish() {
+        estimate_.position_cm = tracker_.getPosition();
+        estimate_.velocity_cm_s = tracker_.getVelocity();
+    }
+};
+
+#endif // DISTANCEFILTER_H
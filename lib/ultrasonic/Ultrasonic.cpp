@@ -4,9 +4,40 @@
  */
 
 #include "Ultrasonic.h"
+#include "UltrasonicCalibration.h"
+#include "GpioIrq.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "hardware/adc.h"
+
+// Speed of sound in 0.1 m/s steps, indexed by air temperature in °C
+// c = 331.3 + 0.606 * T  (m/s)
+static constexpr int8_t SOUND_TABLE_MIN_C = -20;
+static constexpr int8_t SOUND_TABLE_MAX_C = 60;
+static constexpr uint32_t SOUND_TABLE_SIZE = SOUND_TABLE_MAX_C - SOUND_TABLE_MIN_C + 1;
+
+struct SoundSpeedTable {
+    uint16_t dm_per_s[SOUND_TABLE_SIZE];
+    
+    constexpr SoundSpeedTable() : dm_per_s() {
+        for (uint32_t i = 0; i < SOUND_TABLE_SIZE; i++) {
+            int32_t temperature_c = SOUND_TABLE_MIN_C + (int32_t)i;
+            dm_per_s[i] = (uint16_t)((331300 + 606 * temperature_c + 50) / 100);
+        }
+    }
+};
+
+static constexpr SoundSpeedTable SOUND_SPEED_TABLE;
 
 Ultrasonic::Ultrasonic(uint8_t trigger_pin, uint8_t echo_pin)
-    : trigger_pin_(trigger_pin), echo_pin_(echo_pin) {
+    : trigger_pin_(trigger_pin), echo_pin_(echo_pin),
+      echo_state_(ECHO_IDLE), trigger_time_us_(0), echo_start_us_(0), echo_end_us_(0),
+      rise_timeout_us_(TIMEOUT_US), max_echo_us_(TIMEOUT_US),
+      window_min_echo_us_(0), window_max_echo_us_(TIMEOUT_US),
+      last_distance_um_(-1), last_echo_us_(0), calibration_(nullptr),
+      temperature_c_(REFERENCE_TEMPERATURE_C),
+      temperature_auto_(true), temperature_time_ms_(0),
+      callback_(nullptr), callback_user_data_(nullptr) {
 }
 
 void Ultrasonic::init() {
@@ -19,24 +50,53 @@ void Ultrasonic::init() {
     gpio_init(echo_pin_);
     gpio_set_dir(echo_pin_, GPIO_IN);
     
+    // Register for echo edge interrupts
+    GpioIrq::attach(echo_pin_, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, onEchoEdge, this);
+    gpio_acknowledge_irq(echo_pin_, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL);
+    gpio_set_irq_enabled(echo_pin_, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+    
+    // On-die temperature sensor for speed-of-sound compensation
+    // (the ADC may already be free-running for motor current sense)
+    if (!(adc_hw->cs & ADC_CS_EN_BITS)) {
+        adc_init();
+    }
+    adc_set_temp_sensor_enabled(true);
+    updateTemperature();
+    
     sleep_ms(50);  // Allow sensor to stabilize
 }
 
 float Ultrasonic::measureDistance() {
-    // Send trigger pulse
-    sendTrigger();
-    
-    // Measure echo pulse duration
-    uint32_t pulse_duration = measureEchoPulse();
+    return measureBlocking(0, max_echo_us_);
+}
+
+float Ultrasonic::measureDistance(float min_cm, float max_cm) {
+    return measureBlocking(centimetersToEcho(min_cm), centimetersToEcho(max_cm));
+}
+
+float Ultrasonic::measureBlocking(uint32_t min_echo_us, uint32_t max_echo_us) {
+    uint32_t timeout_start = time_us_32();
     
-    if (pulse_duration == 0) {
-        return -1.0f;  // Measurement failed
+    // Wait for any previous echo to finish before triggering,
+    // but no longer than a full gated measurement would take
+    while (!beginMeasurement(min_echo_us, max_echo_us)) {
+        poll();
+        if ((time_us_32() - timeout_start) > rise_timeout_us_ + max_echo_us_) {
+            return -1.0f;  // Sensor stuck busy
+        }
     }
     
-    // Calculate distance: time * speed of sound / 2
-    float distance_cm = pulse_duration * SOUND_SPEED_CM_PER_US;
+    // Wait for the interrupt to capture both echo edges
+    while (!poll()) {
+        tight_loop_contents();
+    }
     
-    return distance_cm;
+    return getLastDistance();
+}
+
+int32_t Ultrasonic::measureDistanceMm() {
+    measureBlocking(0, max_echo_us_);
+    return getLastDistanceMm();
 }
 
 bool Ultrasonic::isObjectPresent(float threshold_cm) {
@@ -49,6 +109,179 @@ bool Ultrasonic::isObjectPresent(float threshold_cm) {
     return distance <= threshold_cm;
 }
 
+bool Ultrasonic::startMeasurement() {
+    return beginMeasurement(0, max_echo_us_);
+}
+
+bool Ultrasonic::startMeasurement(float min_cm, float max_cm) {
+    return beginMeasurement(centimetersToEcho(min_cm), centimetersToEcho(max_cm));
+}
+
+void Ultrasonic::setMaxRange(float max_range_cm) {
+    if (max_range_cm <= 0.0f) {
+        // Full sensor range
+        rise_timeout_us_ = TIMEOUT_US;
+        max_echo_us_ = TIMEOUT_US;
+        return;
+    }
+    
+    max_echo_us_ = centimetersToEcho(max_range_cm);
+    if (max_echo_us_ > TIMEOUT_US) {
+        max_echo_us_ = TIMEOUT_US;
+    }
+    rise_timeout_us_ = GATED_RISE_TIMEOUT_US;
+}
+
+bool Ultrasonic::beginMeasurement(uint32_t min_echo_us, uint32_t max_echo_us) {
+    if (echo_state_ != ECHO_IDLE) {
+        return false;  // Measurement already in progress
+    }
+    
+    if (gpio_get(echo_pin_) == 1) {
+        return false;  // Sensor still driving the previous echo
+    }
+    
+    // Air temperature drifts slowly; refresh it between pings
+    if (temperature_auto_ &&
+        (to_ms_since_boot(get_absolute_time()) - temperature_time_ms_) >= TEMPERATURE_REFRESH_MS) {
+        updateTemperature();
+    }
+    
+    // Never wait longer than the configured range allows
+    if (max_echo_us > max_echo_us_) {
+        max_echo_us = max_echo_us_;
+    }
+    window_min_echo_us_ = min_echo_us;
+    window_max_echo_us_ = max_echo_us;
+    
+    // Arm before triggering so a fast echo edge is not missed
+    trigger_time_us_ = time_us_32();
+    echo_state_ = ECHO_WAIT_RISE;
+    sendTrigger();
+    
+    return true;
+}
+
+bool Ultrasonic::poll() {
+    uint32_t now = time_us_32();
+    uint32_t pulse_duration = 0;
+    bool finished = false;
+    
+    // Resolve the state atomically with respect to the echo interrupt
+    uint32_t irq_state = save_and_disable_interrupts();
+    switch (echo_state_) {
+        case ECHO_IDLE:
+            break;
+            
+        case ECHO_WAIT_RISE:
+            if ((now - trigger_time_us_) > rise_timeout_us_) {
+                finished = true;  // Echo never started
+            }
+            break;
+            
+        case ECHO_WAIT_FALL:
+            if ((now - echo_start_us_) > window_max_echo_us_) {
+                finished = true;  // Echo ended too late (or never)
+            }
+            break;
+            
+        case ECHO_DONE:
+            pulse_duration = echo_end_us_ - echo_start_us_;
+            if (pulse_duration < window_min_echo_us_ ||
+                pulse_duration > window_max_echo_us_) {
+                pulse_duration = 0;  // Outside expected window
+            }
+            finished = true;
+            break;
+    }
+    if (finished) {
+        echo_state_ = ECHO_IDLE;
+    }
+    restore_interrupts(irq_state);
+    
+    if (!finished) {
+        return false;
+    }
+    
+    completeMeasurement(pulse_duration);
+    return true;
+}
+
+float Ultrasonic::getLastDistance() const {
+    if (last_distance_um_ < 0) {
+        return -1.0f;
+    }
+    return last_distance_um_ / 10000.0f;
+}
+
+int32_t Ultrasonic::getLastDistanceMm() const {
+    if (last_distance_um_ < 0) {
+        return -1;
+    }
+    return (last_distance_um_ + 500) / 1000;
+}
+
+void Ultrasonic::updateTemperature() {
+    // Pause free-running conversions (motor current sense) and keep this
+    // one out of their FIFO
+    bool free_running = (adc_hw->cs & ADC_CS_START_MANY_BITS) != 0;
+    if (free_running) {
+        adc_run(false);
+        while (!(adc_hw->cs & ADC_CS_READY_BITS)) {
+            tight_loop_contents();
+        }
+        hw_clear_bits(&adc_hw->fcs, ADC_FCS_EN_BITS);
+    }
+    
+    // Keep the caller's ADC input selection
+    uint previous_input = adc_get_selected_input();
+    adc_select_input(TEMPERATURE_ADC_INPUT);
+    uint32_t raw = adc_read();
+    adc_select_input(previous_input);
+    
+    if (free_running) {
+        hw_set_bits(&adc_hw->fcs, ADC_FCS_EN_BITS);
+        adc_run(true);
+    }
+    
+    // V = raw * 3.3V / 4096, T = 27 - (V - 0.706) / 0.001721
+    int32_t sensor_uv = (int32_t)((raw * 51563) / 64);
+    int32_t temperature_mc = 27000 - (int32_t)(((int64_t)(sensor_uv - 706000) * 1000) / 1721);
+    
+    // Round to whole degrees
+    int32_t temperature_c = (temperature_mc + (temperature_mc >= 0 ? 500 : -500)) / 1000;
+    if (temperature_c < SOUND_TABLE_MIN_C) temperature_c = SOUND_TABLE_MIN_C;
+    if (temperature_c > SOUND_TABLE_MAX_C) temperature_c = SOUND_TABLE_MAX_C;
+    
+    temperature_c_ = (int8_t)temperature_c;
+    temperature_time_ms_ = to_ms_since_boot(get_absolute_time());
+}
+
+void Ultrasonic::setTemperature(int8_t temperature_c) {
+    temperature_c_ = temperature_c;
+    temperature_auto_ = false;
+}
+
+void Ultrasonic::setCalibration(const UltrasonicCalibration* calibration) {
+    calibration_ = calibration;
+}
+
+uint32_t Ultrasonic::getLastReferenceEchoUs() const {
+    // Scale to the echo the same distance would give at 20°C
+    uint32_t speed_now = echoToMicrometers(1000, temperature_c_);
+    uint32_t speed_ref = echoToMicrometers(1000, REFERENCE_TEMPERATURE_C);
+    return (last_echo_us_ * speed_now) / speed_ref;
+}
+
+bool Ultrasonic::isBusy() const {
+    return echo_state_ != ECHO_IDLE;
+}
+
+void Ultrasonic::setCallback(MeasurementCallback callback, void* user_data) {
+    callback_ = callback;
+    callback_user_data_ = user_data;
+}
+
 void Ultrasonic::sendTrigger() {
     // Send 10µs pulse on trigger pin
     gpio_put(trigger_pin_, 0);
@@ -58,36 +291,55 @@ void Ultrasonic::sendTrigger() {
     gpio_put(trigger_pin_, 0);
 }
 
-uint32_t Ultrasonic::measureEchoPulse() {
-    uint32_t timeout_start;
-    uint32_t pulse_start;
-    uint32_t pulse_end;
+void Ultrasonic::completeMeasurement(uint32_t pulse_duration) {
+    last_echo_us_ = pulse_duration;
     
-    // Wait for echo pin to go LOW (in case it's HIGH)
-    timeout_start = to_us_since_boot(get_absolute_time());
-    while (gpio_get(echo_pin_) == 1) {
-        if ((to_us_since_boot(get_absolute_time()) - timeout_start) > TIMEOUT_US) {
-            return 0;  // Timeout
-        }
+    if (pulse_duration == 0) {
+        last_distance_um_ = -1;  // Measurement failed
+    } else if (calibration_ != nullptr && calibration_->isValid()) {
+        last_distance_um_ = calibration_->apply(getLastReferenceEchoUs());
+    } else {
+        last_distance_um_ = (int32_t)echoToMicrometers(pulse_duration, temperature_c_);
     }
     
-    // Wait for echo pin to go HIGH (start of pulse)
-    timeout_start = to_us_since_boot(get_absolute_time());
-    while (gpio_get(echo_pin_) == 0) {
-        if ((to_us_since_boot(get_absolute_time()) - timeout_start) > TIMEOUT_US) {
-            return 0;  // Timeout
-        }
+    if (callback_ != nullptr) {
+        callback_(getLastDistance(), callback_user_data_);
     }
-    pulse_start = to_us_since_boot(get_absolute_time());
+}
+
+uint32_t Ultrasonic::echoToMicrometers(uint32_t echo_us, int8_t temperature_c) {
+    if (temperature_c < SOUND_TABLE_MIN_C) temperature_c = SOUND_TABLE_MIN_C;
+    if (temperature_c > SOUND_TABLE_MAX_C) temperature_c = SOUND_TABLE_MAX_C;
     
-    // Wait for echo pin to go LOW (end of pulse)
-    while (gpio_get(echo_pin_) == 1) {
-        if ((to_us_since_boot(get_absolute_time()) - pulse_start) > TIMEOUT_US) {
-            return 0;  // Timeout
-        }
+    // Calculate distance: time * speed of sound / 2
+    // 1µs * 1m/s = 1µm, speed is in 0.1m/s units -> divide by 2 * 10
+    uint32_t speed_dm_per_s = SOUND_SPEED_TABLE.dm_per_s[temperature_c - SOUND_TABLE_MIN_C];
+    return (echo_us * speed_dm_per_s) / 20;
+}
+
+float Ultrasonic::echoToCentimeters(uint32_t echo_us) {
+    return echoToMicrometers(echo_us, REFERENCE_TEMPERATURE_C) / 10000.0f;
+}
+
+uint32_t Ultrasonic::centimetersToEcho(float distance_cm) {
+    if (distance_cm <= 0.0f) {
+        return 0;
+    }
+    return (uint32_t)(distance_cm / SOUND_SPEED_CM_PER_US);
+}
+
+void Ultrasonic::handleEchoEdge(uint32_t events, uint32_t timestamp_us) {
+    if ((events & GPIO_IRQ_EDGE_RISE) && echo_state_ == ECHO_WAIT_RISE) {
+        echo_start_us_ = timestamp_us;
+        echo_state_ = ECHO_WAIT_FALL;
     }
-    pulse_end = to_us_since_boot(get_absolute_time());
     
-    // Calculate pulse duration
-    return pulse_end - pulse_start;
+    if ((events & GPIO_IRQ_EDGE_FALL) && echo_state_ == ECHO_WAIT_FALL) {
+        echo_end_us_ = timestamp_us;
+        echo_state_ = ECHO_DONE;
+    }
+}
+
+void Ultrasonic::onEchoEdge(void* user_data, uint32_t events, uint32_t timestamp_us) {
+    static_cast<Ultrasonic*>(user_data)->handleEchoEdge(events, timestamp_us);
 }
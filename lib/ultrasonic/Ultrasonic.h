@@ -8,11 +8,28 @@
  * 
  * Pin Configuration:
  * - Trigger: GPIO output pin
- * - Echo: GPIO input pin
+ * - Echo: GPIO input pin (edge interrupts)
  * 
  * Timing:
  * - Trigger pulse: 10µs
  * - Echo timeout: 30ms (max distance)
+ * 
+ * Measurement Modes:
+ * - Non-blocking: startMeasurement() then poll() from the main loop.
+ *   The echo rising/falling edges are timestamped in a GPIO interrupt,
+ *   so no CPU time is spent waiting for the echo.
+ * - Blocking: measureDistance() (thin wrapper around the above)
+ * 
+ * Distance Conversion:
+ * - Integer path (µm / mm) using a speed-of-sound table indexed by
+ *   air temperature, read from the RP2040 on-die sensor every 10s
+ * - Float API (cm) is a wrapper around the integer result
+ * - Optional UltrasonicCalibration table corrects short-range bias
+ * 
+ * Range Gating:
+ * - setMaxRange() shortens the echo timeout to the working range
+ * - An expected-distance window per measurement abandons echoes that
+ *   cannot fall inside it (e.g. ~1ms worst case on a 15cm rail)
  */
 
 #ifndef ULTRASONIC_H
@@ -21,8 +38,17 @@
 #include "pico/stdlib.h"
 #include <cstdint>
 
+class UltrasonicCalibration;
+
 class Ultrasonic {
 public:
+    /**
+     * @brief Callback invoked by poll() when a measurement finishes
+     * @param distance_cm Distance in cm, or -1.0 if measurement failed
+     * @param user_data Pointer passed to setCallback()
+     */
+    typedef void (*MeasurementCallback)(float distance_cm, void* user_data);
+    
     /**
      * @brief Constructor for HC-SR04 ultrasonic sensor
      * @param trigger_pin GPIO pin for trigger signal
@@ -31,16 +57,30 @@ public:
     Ultrasonic(uint8_t trigger_pin, uint8_t echo_pin);
     
     /**
-     * @brief Initialize the sensor GPIO pins
+     * @brief Initialize the sensor GPIO pins and echo interrupt
      */
     void init();
     
     /**
-     * @brief Measure distance in centimeters
+     * @brief Measure distance in centimeters (blocking)
      * @return Distance in cm, or -1.0 if measurement failed
      */
     float measureDistance();
     
+    /**
+     * @brief Measure distance within an expected window (blocking)
+     * @param min_cm Nearest expected distance in cm
+     * @param max_cm Farthest expected distance in cm
+     * @return Distance in cm, or -1.0 if failed or outside the window
+     */
+    float measureDistance(float min_cm, float max_cm);
+    
+    /**
+     * @brief Measure distance in millimeters (blocking, integer only)
+     * @return Distance in mm, or -1 if measurement failed
+     */
+    int32_t measureDistanceMm();
+    
     /**
      * @brief Check if an object is present within threshold
      * @param threshold_cm Distance threshold in cm
@@ -48,13 +88,168 @@ public:
      */
     bool isObjectPresent(float threshold_cm = 10.0f);
     
+    /**
+     * @brief Send a trigger pulse and return immediately (non-blocking)
+     * @return true if started, false if a measurement is in progress
+     *         or the sensor is still driving the previous echo
+     */
+    bool startMeasurement();
+    
+    /**
+     * @brief Start a measurement gated to an expected window (non-blocking)
+     * Echoes outside [min_cm, max_cm] are abandoned as soon as possible.
+     * @param min_cm Nearest expected distance in cm
+     * @param max_cm Farthest expected distance in cm
+     * @return true if started (see startMeasurement())
+     */
+    bool startMeasurement(float min_cm, float max_cm);
+    
+    /**
+     * @brief Limit measurements to a maximum range
+     * Shortens the echo timeout from 30ms (4m) to what the range needs.
+     * @param max_range_cm Maximum range in cm, or 0 to restore full range
+     */
+    void setMaxRange(float max_range_cm);
+    
+    /**
+     * @brief Advance the measurement (call in main loop)
+     * Handles timeouts and fires the completion callback.
+     * @return true once per finished measurement (success or failure)
+     */
+    bool poll();
+    
+    /**
+     * @brief Check if a measurement is in progress
+     * @return true between startMeasurement() and completion
+     */
+    bool isBusy() const;
+    
+    /**
+     * @brief Get the result of the last finished measurement
+     * @return Distance in cm, or -1.0 if the last measurement failed
+     */
+    float getLastDistance() const;
+    
+    /**
+     * @brief Get the result of the last finished measurement
+     * @return Distance in micrometers, or -1 if the last measurement failed
+     */
+    int32_t getLastDistanceUm() const { return last_distance_um_; }
+    
+    /**
+     * @brief Get the result of the last finished measurement
+     * @return Distance in millimeters, or -1 if the last measurement failed
+     */
+    int32_t getLastDistanceMm() const;
+    
+    /**
+     * @brief Read the on-die temperature sensor now
+     * Called automatically every TEMPERATURE_REFRESH_MS when a
+     * measurement starts.
+     */
+    void updateTemperature();
+    
+    /**
+     * @brief Override the air temperature (disables automatic refresh)
+     * @param temperature_c Air temperature in °C
+     */
+    void setTemperature(int8_t temperature_c);
+    
+    /**
+     * @brief Get the temperature used for distance conversion
+     * @return Air temperature in °C
+     */
+    int8_t getTemperature() const { return temperature_c_; }
+    
+    /**
+     * @brief Use a calibration table for distance conversion
+     * @param calibration Table to use (must outlive the sensor), or nullptr
+     */
+    void setCalibration(const UltrasonicCalibration* calibration);
+    
+    /**
+     * @brief Get the raw echo width of the last finished measurement
+     * @return Echo width in microseconds, 0 if the last measurement failed
+     */
+    uint32_t getLastEchoUs() const { return last_echo_us_; }
+    
+    /**
+     * @brief Get the last echo width normalised to 20°C
+     * Used to capture calibration points independent of air temperature.
+     * @return Echo width in microseconds, 0 if the last measurement failed
+     */
+    uint32_t getLastReferenceEchoUs() const;
+    
+    /**
+     * @brief Set completion callback (called from poll(), not from the IRQ)
+     * @param callback Function to call, or nullptr to disable
+     * @param user_data Pointer passed back to the callback
+     */
+    void setCallback(MeasurementCallback callback, void* user_data = nullptr);
+    
+    /**
+     * @brief Convert an echo pulse width to distance (integer only)
+     * @param echo_us Echo pulse width in microseconds
+     * @param temperature_c Air temperature in °C
+     * @return Distance in micrometers
+     */
+    static uint32_t echoToMicrometers(uint32_t echo_us, int8_t temperature_c);
+    
+    /**
+     * @brief Convert an echo pulse width to distance at 20°C
+     * @param echo_us Echo pulse width in microseconds
+     * @return Distance in cm
+     */
+    static float echoToCentimeters(uint32_t echo_us);
+    
+    /**
+     * @brief Convert a distance to the expected echo pulse width
+     * @param distance_cm Distance in cm
+     * @return Echo pulse width in microseconds
+     */
+    static uint32_t centimetersToEcho(float distance_cm);
+    
 private:
+    enum EchoState {
+        ECHO_IDLE,        // No measurement in progress
+        ECHO_WAIT_RISE,   // Trigger sent, waiting for echo start
+        ECHO_WAIT_FALL,   // Echo high, waiting for echo end
+        ECHO_DONE         // Both edges captured, waiting for poll()
+    };
+    
     uint8_t trigger_pin_;
     uint8_t echo_pin_;
     
+    volatile EchoState echo_state_;
+    volatile uint32_t trigger_time_us_;
+    volatile uint32_t echo_start_us_;
+    volatile uint32_t echo_end_us_;
+    
+    // Range gating (echo widths in microseconds)
+    uint32_t rise_timeout_us_;     // Trigger to echo start
+    uint32_t max_echo_us_;         // From setMaxRange()
+    uint32_t window_min_echo_us_;  // Current measurement window
+    uint32_t window_max_echo_us_;
+    
+    int32_t last_distance_um_;
+    uint32_t last_echo_us_;
+    const UltrasonicCalibration* calibration_;
+    int8_t temperature_c_;
+    bool temperature_auto_;
+    uint32_t temperature_time_ms_;
+    MeasurementCallback callback_;
+    void* callback_user_data_;
+    
     static constexpr uint32_t TRIGGER_PULSE_US = 10;
     static constexpr uint32_t TIMEOUT_US = 30000;  // 30ms timeout
-    static constexpr float SOUND_SPEED_CM_PER_US = 0.0343f / 2.0f;  // Divided by 2 for round trip
+    // Trigger-to-echo-rise latency is independent of range: the module sends
+    // its 8-cycle burst (~200us) before raising echo, and the delay varies
+    // between modules (some clones take over 2ms). Keep generous margin.
+    static constexpr uint32_t GATED_RISE_TIMEOUT_US = 4000;  // Echo start latency when range gated
+    static constexpr float SOUND_SPEED_CM_PER_US = 0.0343f / 2.0f;  // Divided by 2 for round trip (range gating only)
+    static constexpr int8_t REFERENCE_TEMPERATURE_C = 20;
+    static constexpr uint32_t TEMPERATURE_REFRESH_MS = 10000;  // Air temperature changes slowly
+    static constexpr uint TEMPERATURE_ADC_INPUT = 4;  // RP2040 on-die sensor
     
     /**
      * @brief Send trigger pulse
@@ -62,10 +257,41 @@ private:
     void sendTrigger();
     
     /**
-     * @brief Wait for echo pulse and measure duration
-     * @return Pulse duration in microseconds, 0 if timeout
+     * @brief Arm the echo state machine with a window and send the trigger
+     * @param min_echo_us Shortest acceptable echo in microseconds
+     * @param max_echo_us Longest acceptable echo in microseconds
+     * @return true if started
+     */
+    bool beginMeasurement(uint32_t min_echo_us, uint32_t max_echo_us);
+    
+    /**
+     * @brief Wait for a measurement to start and finish (blocking)
+     * @param min_echo_us Shortest acceptable echo in microseconds
+     * @param max_echo_us Longest acceptable echo in microseconds
+     * @return Distance in cm, or -1.0 if failed
+     */
+    float measureBlocking(uint32_t min_echo_us, uint32_t max_echo_us);
+    
+    /**
+     * @brief Finish the current measurement and store the result
+     * @param pulse_duration Echo pulse width in microseconds, 0 if failed
+     */
+    void completeMeasurement(uint32_t pulse_duration);
+    
+    /**
+     * @brief Record an echo edge (called from the GPIO interrupt)
+     * @param events GPIO_IRQ_EDGE_RISE / GPIO_IRQ_EDGE_FALL event mask
+     * @param timestamp_us Time of the interrupt in microseconds
+     */
+    void handleEchoEdge(uint32_t events, uint32_t timestamp_us);
+    
+    /**
+     * @brief Echo edge callback (see GpioIrq)
+     * @param user_data Ultrasonic instance
+     * @param events GPIO_IRQ_EDGE_RISE / GPIO_IRQ_EDGE_FALL event mask
+     * @param timestamp_us Time of the interrupt in microseconds
      */
-    uint32_t measureEchoPulse();
+    static void onEchoEdge(void* user_data, uint32_t events, uint32_t timestamp_us);
 };
 
 #endif // ULTRASONIC_H
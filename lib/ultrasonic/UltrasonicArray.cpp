@@ -0,0 +1,12 @@
+/**
+ * @file UltrasonicArray.cpp
+ * @brief Explicit instantiations of the multi-sensor array
+ * 
+ * The array is header-only; instantiating the sizes in use here makes the
+ * library compile (and type-check) the template even before an
+ * application includes it.
+ */
+
+#include "UltrasonicArray.h"
+
+template class UltrasonicArray<2>;  // One sensor at each end of the rail
@@ -0,0 +1,219 @@
+/**
+ * @file UltrasonicArray.h
+ * @brief Multi-sensor HC-SR04 array with staggered firing and voting
+ * 
+ * Owns N trigger/echo pairs and fires them one at a time, round-robin,
+ * using the non-blocking Ultrasonic API. Only one sensor is listening at
+ * any moment and a guard time between pings lets echoes decay, which
+ * avoids crosstalk while keeping the aggregate ping rate at the limit set
+ * by each sensor's (range-gated) echo time.
+ * 
+ * Each sensor has a mounting offset and direction so readings can be
+ * converted into a common rail coordinate, e.g. one sensor at each end:
+ * - Sensor 0 at 0cm facing the carriage:      offset 0,   reversed false
+ * - Sensor 1 at 30cm facing back toward home: offset 30,  reversed true
+ * 
+ * getPosition() votes across fresh readings: the position supported by
+ * a strict majority of sensors wins.
+ */
+
+#ifndef ULTRASONICARRAY_H
+#define ULTRASONICARRAY_H
+
+#include "pico/stdlib.h"
+#include "Ultrasonic.h"
+#include <cstdint>
+#include <utility>
+
+/**
+ * @brief Result of voting across sensors
+ */
+struct ArrayPosition {
+    float position_cm;  // Voted position in rail coordinates
+    uint8_t agreeing;   // Sensors supporting the voted position
+    uint8_t fresh;      // Sensors with a recent valid reading
+    bool valid;         // true if a strict majority agreed
+};
+
+template <uint8_t N>
+class UltrasonicArray {
+public:
+    /**
+     * @brief Constructor for ultrasonic array
+     * @param trigger_pins Array of N GPIO pins for trigger signals
+     * @param echo_pins Array of N GPIO pins for echo signals
+     */
+    UltrasonicArray(const uint8_t (&trigger_pins)[N], const uint8_t (&echo_pins)[N])
+        : UltrasonicArray(trigger_pins, echo_pins, std::make_index_sequence<N>{}) {}
+    
+    /**
+     * @brief Initialize all sensors
+     */
+    void init() {
+        for (uint8_t i = 0; i < N; i++) {
+            sensors_[i].init();
+        }
+        last_done_us_ = time_us_32();
+    }
+    
+    /**
+     * @brief Set where a sensor sits on the rail and which way it faces
+     * @param index Sensor index
+     * @param offset_cm Sensor position in rail coordinates
+     * @param reversed true if distance grows toward lower rail coordinates
+     */
+    void setMounting(uint8_t index, float offset_cm, bool reversed) {
+        mountings_[index].offset_cm = offset_cm;
+        mountings_[index].reversed = reversed;
+    }
+    
+    /**
+     * @brief Set quiet time between consecutive pings (crosstalk guard)
+     * @param guard_us Guard time in microseconds
+     */
+    void setGuardTime(uint32_t guard_us) { guard_us_ = guard_us; }
+    
+    /**
+     * @brief Limit all sensors to a maximum range
+     * @param max_range_cm Maximum range in cm, or 0 for full range
+     */
+    void setMaxRange(float max_range_cm) {
+        for (uint8_t i = 0; i < N; i++) {
+            sensors_[i].setMaxRange(max_range_cm);
+        }
+    }
+    
+    /**
+     * @brief Run the firing scheduler (call in main loop)
+     * @return true if a new reading was recorded
+     */
+    bool update() {
+        uint32_t now = time_us_32();
+        bool recorded = false;
+        
+        if (active_) {
+            Ultrasonic& sensor = sensors_[current_];
+            if (!sensor.poll()) {
+                return false;  // Still listening
+            }
+            
+            readings_[current_].distance_um = sensor.getLastDistanceUm();
+            readings_[current_].timestamp_us = now;
+            readings_[current_].valid = sensor.getLastDistanceUm() >= 0;
+            recorded = true;
+            
+            active_ = false;
+            last_done_us_ = now;
+            current_ = (current_ + 1) % N;
+        }
+        
+        if ((now - last_done_us_) >= guard_us_) {
+            // A sensor still driving an abandoned echo is skipped this round
+            for (uint8_t tries = 0; tries < N && !active_; tries++) {
+                if (sensors_[current_].startMeasurement()) {
+                    active_ = true;
+                } else {
+                    current_ = (current_ + 1) % N;
+                }
+            }
+        }
+        
+        return recorded;
+    }
+    
+    /**
+     * @brief Get the latest distance from one sensor
+     * @param index Sensor index
+     * @return Distance in cm (sensor frame), or -1.0 if no valid reading
+     */
+    float getDistance(uint8_t index) const {
+        if (!readings_[index].valid) {
+            return -1.0f;
+        }
+        return readings_[index].distance_um / 10000.0f;
+    }
+    
+    /**
+     * @brief Vote on the carriage position across fresh readings
+     * @param max_age_us Ignore readings older than this
+     * @param tolerance_cm Readings within this distance agree
+     * @return Voted position
+     */
+    ArrayPosition getPosition(uint32_t max_age_us, float tolerance_cm) const {
+        ArrayPosition result = {0.0f, 0, 0, false};
+        float positions[N];
+        uint32_t now = time_us_32();
+        
+        for (uint8_t i = 0; i < N; i++) {
+            if (readings_[i].valid && (now - readings_[i].timestamp_us) <= max_age_us) {
+                float distance_cm = readings_[i].distance_um / 10000.0f;
+                positions[result.fresh++] = mountings_[i].reversed
+                    ? mountings_[i].offset_cm - distance_cm
+                    : mountings_[i].offset_cm + distance_cm;
+            }
+        }
+        
+        if (result.fresh == 0) {
+            return result;
+        }
+        
+        // Pick the reading with the most support, average its supporters
+        for (uint8_t i = 0; i < result.fresh; i++) {
+            uint8_t support = 0;
+            float sum = 0.0f;
+            for (uint8_t j = 0; j < result.fresh; j++) {
+                float diff = positions[j] - positions[i];
+                if (diff >= -tolerance_cm && diff <= tolerance_cm) {
+                    support++;
+                    sum += positions[j];
+                }
+            }
+            if (support > result.agreeing) {
+                result.agreeing = support;
+                result.position_cm = sum / support;
+            }
+        }
+        
+        result.valid = (result.agreeing * 2) > result.fresh;
+        return result;
+    }
+    
+    /**
+     * @brief Access a sensor for per-sensor configuration
+     * @param index Sensor index
+     * @return Sensor driver
+     */
+    Ultrasonic& getSensor(uint8_t index) { return sensors_[index]; }
+    
+    static constexpr uint32_t DEFAULT_GUARD_US = 2000;
+    
+private:
+    struct Mounting {
+        float offset_cm;
+        bool reversed;
+    };
+    
+    struct Reading {
+        int32_t distance_um;
+        uint32_t timestamp_us;
+        bool valid;
+    };
+    
+    Ultrasonic sensors_[N];
+    Mounting mountings_[N];
+    Reading readings_[N];
+    
+    uint32_t guard_us_;
+    uint32_t last_done_us_;
+    uint8_t current_;
+    bool active_;
+    
+    template <size_t... I>
+    UltrasonicArray(const uint8_t (&trigger_pins)[N], const uint8_t (&echo_pins)[N],
+                    std::index_sequence<I...>)
+        : sensors_{Ultrasonic(trigger_pins[I], echo_pins[I])...},
+          mountings_{}, readings_{},
+          guard_us_(DEFAULT_GUARD_US), last_done_us_(0), current_(0), active_(false) {}
+};
+
+#endif // ULTRASONICARRAY_H
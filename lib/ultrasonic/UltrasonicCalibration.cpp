@@ -0,0 +1,85 @@
+/**
+ * @file UltrasonicCalibration.cpp
+ * @brief Implementation of piecewise-linear HC-SR04 calibration
+ */
+
+#include "UltrasonicCalibration.h"
+
+UltrasonicCalibration::UltrasonicCalibration() {
+    clear();
+}
+
+void UltrasonicCalibration::clear() {
+    table_.count = 0;
+}
+
+bool UltrasonicCalibration::addPoint(uint32_t echo_us, int32_t distance_um) {
+    // Find insertion position
+    uint8_t pos = 0;
+    while (pos < table_.count && table_.points[pos].echo_us < echo_us) {
+        pos++;
+    }
+    
+    if (pos < table_.count && table_.points[pos].echo_us == echo_us) {
+        table_.points[pos].distance_um = distance_um;  // Replace
+        return true;
+    }
+    
+    if (table_.count >= MAX_POINTS) {
+        return false;
+    }
+    
+    for (uint8_t i = table_.count; i > pos; i--) {
+        table_.points[i] = table_.points[i - 1];
+    }
+    table_.points[pos].echo_us = echo_us;
+    table_.points[pos].distance_um = distance_um;
+    table_.count++;
+    
+    return true;
+}
+
+int32_t UltrasonicCalibration::apply(uint32_t echo_us) const {
+    if (!isValid()) {
+        return -1;
+    }
+    
+    // Pick the segment containing echo_us (or the nearest end segment)
+    uint8_t upper = 1;
+    while (upper < table_.count - 1 && table_.points[upper].echo_us < echo_us) {
+        upper++;
+    }
+    
+    const Point& a = table_.points[upper - 1];
+    const Point& b = table_.points[upper];
+    
+    // Linear interpolation in integer math
+    int32_t echo_delta = (int32_t)echo_us - (int32_t)a.echo_us;
+    int32_t echo_span = (int32_t)b.echo_us - (int32_t)a.echo_us;
+    int32_t distance_span = b.distance_um - a.distance_um;
+    
+    int32_t distance_um = a.distance_um +
+                          (int32_t)(((int64_t)echo_delta * distance_span) / echo_span);
+    
+    // Extrapolating below the first point can reach zero or go negative,
+    // which callers would mistake for the -1 failure value
+    return (distance_um < MIN_DISTANCE_UM) ? MIN_DISTANCE_UM : distance_um;
+}
+
+bool UltrasonicCalibration::load(const FlashStore& store) {
+    Table loaded;
+    if (!store.load(FLASH_MAGIC, FLASH_VERSION, &loaded, sizeof(loaded))) {
+        return false;
+    }
+    
+    if (loaded.count > MAX_POINTS) {
+        return false;
+    }
+    
+    table_ = loaded;
+    return true;
+}
+
+bool UltrasonicCalibration::save(FlashStore& store) const {
+    return store.save(FLASH_MAGIC, FLASH_VERSION, &table_, sizeof(table_));
+}
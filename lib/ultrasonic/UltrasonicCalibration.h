@@ -0,0 +1,105 @@
+/**
+ * @file UltrasonicCalibration.h
+ * @brief Piecewise-linear calibration table for HC-SR04 readings
+ * 
+ * At short range (2-15cm) the HC-SR04 has a strong non-linear bias.
+ * This table maps echo widths to true distances captured at known
+ * stops, and interpolates linearly between them (extrapolating with
+ * the end segments).
+ * 
+ * Echo widths are stored normalised to 20°C, so one table stays valid
+ * as the air temperature changes (see Ultrasonic::getLastReferenceEchoUs()).
+ * 
+ * The table persists in a flash sector through FlashStore.
+ */
+
+#ifndef ULTRASONICCALIBRATION_H
+#define ULTRASONICCALIBRATION_H
+
+#include "pico/stdlib.h"
+#include "FlashStore.h"
+#include <cstdint>
+
+class UltrasonicCalibration {
+public:
+    static constexpr uint8_t MAX_POINTS = 16;
+    static constexpr int32_t MIN_DISTANCE_UM = 1;  // Floor for extrapolated results
+    
+    /**
+     * @brief One calibration point
+     */
+    struct Point {
+        uint32_t echo_us;     // Echo width normalised to 20°C
+        int32_t distance_um;  // True distance in micrometers
+    };
+    
+    UltrasonicCalibration();
+    
+    /**
+     * @brief Remove all points
+     */
+    void clear();
+    
+    /**
+     * @brief Add a point (kept sorted by echo width)
+     * A point with the same echo width replaces the existing one.
+     * @param echo_us Echo width normalised to 20°C
+     * @param distance_um True distance in micrometers
+     * @return false if the table is full
+     */
+    bool addPoint(uint32_t echo_us, int32_t distance_um);
+    
+    /**
+     * @brief Check if the table can be used
+     * @return true if at least two points are present
+     */
+    bool isValid() const { return table_.count >= 2; }
+    
+    /**
+     * @brief Get number of points
+     * @return Point count
+     */
+    uint8_t getPointCount() const { return table_.count; }
+    
+    /**
+     * @brief Get a point
+     * @param index Point index (sorted by echo width)
+     * @return Calibration point
+     */
+    const Point& getPoint(uint8_t index) const { return table_.points[index]; }
+    
+    /**
+     * @brief Convert an echo width to corrected distance
+     * @param echo_us Echo width normalised to 20°C
+     * @return Distance in micrometers (at least MIN_DISTANCE_UM), or -1 if
+     *         the table is not valid
+     */
+    int32_t apply(uint32_t echo_us) const;
+    
+    /**
+     * @brief Load the table from flash
+     * @param store Flash sector holding the table
+     * @return true if a valid table was loaded
+     */
+    bool load(const FlashStore& store);
+    
+    /**
+     * @brief Save the table to flash
+     * @param store Flash sector to write
+     * @return true on success
+     */
+    bool save(FlashStore& store) const;
+    
+private:
+    struct Table {
+        uint8_t count;
+        Point points[MAX_POINTS];
+    };
+    
+    Table table_;
+    
+    static constexpr uint32_t FLASH_MAGIC = 0x55434C42;  // "UCLB"
+    static constexpr uint16_t FLASH_VERSION = 1;
+};
+
+#endif // ULTRASONICCALIBRATION_H
@@ -0,0 +1,189 @@
+/**
+ * @file UltrasonicRanger.cpp
+ * @brief Implementation of PIO + DMA HC-SR04 ranging engine
+ */
+
+#include "UltrasonicRanger.h"
+#include "Ultrasonic.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+#include "hcsr04.pio.h"
+
+UltrasonicRanger::UltrasonicRanger(uint8_t trigger_pin, uint8_t echo_pin, PIO pio)
+    : trigger_pin_(trigger_pin), echo_pin_(echo_pin), pio_(pio),
+      sm_(0), program_offset_(0), dma_channel_(-1), stamp_dma_channel_(-1), running_(false),
+      samples_{}, timestamps_{} {
+}
+
+bool UltrasonicRanger::init() {
+    if (!pio_can_add_program(pio_, &hcsr04_program)) {
+        return false;
+    }
+    
+    int sm = pio_claim_unused_sm(pio_, false);
+    if (sm < 0) {
+        return false;
+    }
+    sm_ = (uint)sm;
+    
+    dma_channel_ = dma_claim_unused_channel(false);
+    stamp_dma_channel_ = dma_claim_unused_channel(false);
+    if (dma_channel_ < 0 || stamp_dma_channel_ < 0) {
+        // Release whatever was claimed so a retry starts clean
+        if (dma_channel_ >= 0) {
+            dma_channel_unclaim(dma_channel_);
+        }
+        if (stamp_dma_channel_ >= 0) {
+            dma_channel_unclaim(stamp_dma_channel_);
+        }
+        pio_sm_unclaim(pio_, sm_);
+        dma_channel_ = -1;
+        stamp_dma_channel_ = -1;
+        return false;
+    }
+    
+    program_offset_ = pio_add_program(pio_, &hcsr04_program);
+    
+    // Hand the pins to PIO: trigger output, echo input
+    pio_gpio_init(pio_, trigger_pin_);
+    pio_gpio_init(pio_, echo_pin_);
+    pio_sm_set_consecutive_pindirs(pio_, sm_, trigger_pin_, 1, true);
+    pio_sm_set_consecutive_pindirs(pio_, sm_, echo_pin_, 1, false);
+    
+    pio_sm_config c = hcsr04_program_get_default_config(program_offset_);
+    sm_config_set_set_pins(&c, trigger_pin_, 1);
+    sm_config_set_in_pins(&c, echo_pin_);
+    sm_config_set_jmp_pin(&c, echo_pin_);
+    sm_config_set_in_shift(&c, false, false, 32);
+    // No FIFO join: start() hands the holdoff over through the TX FIFO
+    
+    // Run at 2 MHz so the echo count loop ticks once per microsecond
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / PIO_CLOCK_HZ);
+    
+    pio_sm_init(pio_, sm_, program_offset_, &c);
+    
+    return true;
+}
+
+void UltrasonicRanger::start(uint32_t holdoff_us) {
+    if (running_) {
+        stop();
+    }
+    
+    // Restart the program from the top so it picks up the new holdoff
+    pio_sm_clear_fifos(pio_, sm_);
+    pio_sm_restart(pio_, sm_);
+    pio_sm_exec(pio_, sm_, pio_encode_set(pio_pins, 0));
+    pio_sm_exec(pio_, sm_, pio_encode_jmp(program_offset_));
+    pio_sm_put(pio_, sm_, holdoff_us);  // FIFO was just cleared, so this cannot block
+    
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        samples_[i] = 0;
+        timestamps_[i] = 0;
+    }
+    
+    // One sample per trigger from the RX FIFO, then chain to the timestamp copy
+    dma_channel_config dc = dma_channel_get_default_config(dma_channel_);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+    channel_config_set_read_increment(&dc, false);
+    channel_config_set_write_increment(&dc, true);
+    channel_config_set_ring(&dc, true, RING_SIZE_BITS);
+    channel_config_set_dreq(&dc, pio_get_dreq(pio_, sm_, false));
+    channel_config_set_chain_to(&dc, stamp_dma_channel_);
+    
+    dma_channel_configure(dma_channel_, &dc, samples_, &pio_->rxf[sm_], 1, false);
+    
+    // Copy the timer into the matching slot, then re-arm the sample channel
+    // (both write addresses carry on around their rings between triggers)
+    dma_channel_config tc = dma_channel_get_default_config(stamp_dma_channel_);
+    channel_config_set_transfer_data_size(&tc, DMA_SIZE_32);
+    channel_config_set_read_increment(&tc, false);
+    channel_config_set_write_increment(&tc, true);
+    channel_config_set_ring(&tc, true, RING_SIZE_BITS);
+    channel_config_set_chain_to(&tc, dma_channel_);
+    
+    dma_channel_configure(stamp_dma_channel_, &tc, timestamps_, &timer_hw->timerawl, 1, false);
+    dma_channel_start(dma_channel_);
+    
+    pio_sm_set_enabled(pio_, sm_, true);
+    running_ = true;
+}
+
+void UltrasonicRanger::stop() {
+    pio_sm_set_enabled(pio_, sm_, false);
+    
+    // Break the chain before aborting so neither channel restarts the other
+    dma_channel_config dc = dma_get_channel_config(dma_channel_);
+    channel_config_set_chain_to(&dc, dma_channel_);
+    dma_channel_set_config(dma_channel_, &dc, false);
+    dma_channel_config tc = dma_get_channel_config(stamp_dma_channel_);
+    channel_config_set_chain_to(&tc, stamp_dma_channel_);
+    dma_channel_set_config(stamp_dma_channel_, &tc, false);
+    
+    dma_channel_abort(dma_channel_);
+    dma_channel_abort(stamp_dma_channel_);
+    running_ = false;
+}
+
+uint32_t UltrasonicRanger::latestSlot() const {
+    // The slot before the timestamp channel's write pointer is complete
+    uint32_t next = ((uint32_t)dma_channel_hw_addr(stamp_dma_channel_)->write_addr -
+                     (uint32_t)(uintptr_t)timestamps_) / sizeof(uint32_t);
+    return (next - 1) & (RING_SIZE - 1);
+}
+
+bool UltrasonicRanger::getLatestEcho(uint32_t* echo_us, uint32_t* age_us) const {
+    if (stamp_dma_channel_ < 0) {
+        return false;
+    }
+    
+    uint32_t slot = latestSlot();
+    uint32_t timestamp_us = timestamps_[slot];
+    if (timestamp_us == 0) {
+        return false;  // Nothing captured since start()
+    }
+    
+    if (age_us != nullptr) {
+        *age_us = time_us_32() - timestamp_us;
+    }
+    *echo_us = samples_[slot];
+    return *echo_us != NO_ECHO;
+}
+
+float UltrasonicRanger::getDistance(uint32_t max_age_us) const {
+    uint32_t echo_us;
+    uint32_t age_us;
+    if (!getLatestEcho(&echo_us, &age_us) || age_us > max_age_us) {
+        return -1.0f;
+    }
+    return Ultrasonic::echoToCentimeters(echo_us);
+}
+
+bool UltrasonicRanger::readNext(uint32_t& cursor, uint32_t* echo_us) const {
+    if (stamp_dma_channel_ < 0) {
+        return false;
+    }
+    
+    // Oldest sample captured after the cursor, searching back from the latest
+    uint32_t now = time_us_32();
+    uint32_t slot = latestSlot();
+    int32_t found = -1;
+    
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        uint32_t s = (slot - i) & (RING_SIZE - 1);
+        uint32_t timestamp_us = timestamps_[s];
+        if (timestamp_us == 0 || (now - timestamp_us) >= (now - cursor)) {
+            break;  // Empty, or not newer than the cursor
+        }
+        found = (int32_t)s;
+    }
+    
+    if (found < 0) {
+        return false;  // Caught up
+    }
+    
+    *echo_us = samples_[found];
+    cursor = timestamps_[found];
+    return true;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file UltrasonicRanger.h
+ * @brief Continuous HC-SR04 ranging engine using PIO + DMA
+ * 
+ * A PIO state machine generates the trigger pulse and counts the echo
+ * width in microseconds. A DMA channel streams every result from the
+ * PIO RX FIFO into a RAM ring buffer and chains to a second channel that
+ * copies the microsecond timer into a parallel ring, so every sample is
+ * timestamped and the CPU does no work per sample.
+ * 
+ * A ping whose echo never rises yields NO_ECHO instead of stalling the
+ * engine; getLatestEcho()/getDistance() report it as a missing reading.
+ * 
+ * Pin Configuration:
+ * - Trigger: PIO SET pin (output)
+ * - Echo: PIO IN/JMP pin (input)
+ * 
+ * Timing:
+ * - Trigger pulse: 10µs (fixed in hcsr04.pio)
+ * - Echo rise timeout: ~4ms, rise detected within 4µs
+ * - Ping period: echo width + holdoff (set in start())
+ * 
+ * Note: The ranger owns the trigger/echo pins. Do not call
+ * Ultrasonic::init() on the same pins.
+ */
+
+#ifndef ULTRASONICRANGER_H
+#define ULTRASONICRANGER_H
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include <cstdint>
+
+class UltrasonicRanger {
+public:
+    /**
+     * @brief Constructor for the PIO ranging engine
+     * @param trigger_pin GPIO pin for trigger signal
+     * @param echo_pin GPIO pin for echo signal
+     * @param pio PIO block to run the state machine on (default pio0)
+     */
+    UltrasonicRanger(uint8_t trigger_pin, uint8_t echo_pin, PIO pio = pio0);
+    
+    /**
+     * @brief Load the PIO program and claim a state machine and DMA channels
+     * @return true on success, false if PIO/DMA resources are exhausted
+     */
+    bool init();
+    
+    /**
+     * @brief Start continuous ranging
+     * @param holdoff_us Quiet time between pings to let echoes decay
+     */
+    void start(uint32_t holdoff_us = DEFAULT_HOLDOFF_US);
+    
+    /**
+     * @brief Stop continuous ranging
+     */
+    void stop();
+    
+    /**
+     * @brief Check if ranging is running
+     * @return true between start() and stop()
+     */
+    bool isRunning() const { return running_; }
+    
+    /**
+     * @brief Get the most recent echo width
+     * @param echo_us Output echo width in microseconds
+     * @param age_us Optional output: time since the sample was captured
+     * @return true if a sample exists and its ping got an echo
+     */
+    bool getLatestEcho(uint32_t* echo_us, uint32_t* age_us = nullptr) const;
+    
+    /**
+     * @brief Get the most recent distance
+     * @param max_age_us Treat older samples as missing
+     * @return Distance in cm, or -1.0 if no fresh echo is available
+     */
+    float getDistance(uint32_t max_age_us = DEFAULT_MAX_AGE_US) const;
+    
+    /**
+     * @brief Read the next unread sample for a streaming consumer
+     * If the consumer fell more than RING_SIZE samples behind, the oldest
+     * samples are skipped.
+     * @param cursor Capture time of the last sample read (start at 0, updated on success)
+     * @param echo_us Output echo width in microseconds, or NO_ECHO
+     * @return true if a sample was read, false if caught up
+     */
+    bool readNext(uint32_t& cursor, uint32_t* echo_us) const;
+    
+    static constexpr uint32_t RING_SIZE = 32;             // Samples (power of 2)
+    static constexpr uint32_t DEFAULT_HOLDOFF_US = 10000; // 10ms between pings
+    static constexpr uint32_t DEFAULT_MAX_AGE_US = 100000;
+    static constexpr uint32_t NO_ECHO = 0xFFFFFFFF;       // Pushed when the echo never rose
+    
+private:
+    uint8_t trigger_pin_;
+    uint8_t echo_pin_;
+    PIO pio_;
+    uint sm_;
+    uint program_offset_;
+    int dma_channel_;
+    int stamp_dma_channel_;
+    bool running_;
+    
+    // DMA ring buffers; must be aligned to their size for address wrapping.
+    // Slot i of timestamps_ is written right after slot i of samples_
+    // (0 = empty, cleared by start()).
+    static constexpr uint32_t RING_SIZE_BITS = 7;  // log2(RING_SIZE * 4 bytes)
+    alignas(RING_SIZE * sizeof(uint32_t)) volatile uint32_t samples_[RING_SIZE];
+    alignas(RING_SIZE * sizeof(uint32_t)) volatile uint32_t timestamps_[RING_SIZE];
+    
+    static constexpr uint32_t PIO_CLOCK_HZ = 2000000;  // 2 cycles per µs of echo
+    
+    /**
+     * @brief Get the ring slot of the latest complete (timestamped) sample
+     * @return Slot index
+     */
+    uint32_t latestSlot() const;
+};
+
+#endif // ULTRASONICRANGER_H
@@ -37,10 +37,23 @@
 
 #include "Keypad4x4.h"
 #include "Ultrasonic.h"
+#include "DistanceFilter.h"
+#include "UltrasonicCalibration.h"
+#include "FlashStore.h"
+#include "PositionController.h"
+#include "MotionPlanner.h"
+#include "MotionController.h"
+#include "Encoder.h"
+#include "EncoderFusion.h"
+#include "PositionObserver.h"
+#include "RailCalibration.h"
+#include "StopDistanceModel.h"
 #include "MotorDriver.h"
 #include "ServoController.h"
+#include "ServoGroup.h"
 #include "Buzzer.h"
 #include "PushButton.h"
+#include "LimitSwitch.h"
 #include "config.h"
 
 // ============================================================================
@@ -49,9 +62,33 @@
 
 Keypad4x4 keypad(KEYPAD_ROW_PINS, KEYPAD_COL_PINS);
 Ultrasonic ultrasonic(ULTRASONIC_TRIGGER_PIN, ULTRASONIC_ECHO_PIN);
+DistanceFilter<3> positionFilter(FILTER_ALPHA, FILTER_BETA, FILTER_MAX_JUMP_CM);
+UltrasonicCalibration sensorCalibration;
+FlashStore sensorCalibrationStore(FLASH_SECTOR_SENSOR_CAL);
 MotorDriver motor(MOTOR_IN1_PIN, MOTOR_IN2_PIN, MOTOR_ENA_PIN);
-ServoController boxServo(SERVO_BOX_PIN);           // Servo #1 - Drop gate
-ServoController boardLidServo(SERVO_BOARD_LID_PIN); // Servo #2 - Board reset
+PositionController positionController(motor, POSITION_KP, POSITION_KI, POSITION_KD,
+                                      POSITION_KFF);
+StopDistanceModel stopDistanceModel(STOP_MODEL_MAX_SPEED_CM_S, STOP_MODEL_LEARNING_RATE);
+MotionPlanner motionPlanner(MOTION_MAX_VELOCITY_CM_S, MOTION_MAX_ACCEL_CM_S2,
+                            MOTION_MAX_JERK_CM_S3);
+Encoder encoder(ENCODER_PIN_A);
+EncoderFusion encoderFusion(ENCODER_CM_PER_COUNT, ENCODER_FUSION_GAIN);
+PositionObserver positionObserver(motor, OBSERVER_POSITION_GAIN, OBSERVER_VELOCITY_GAIN,
+                                  OBSERVER_LEARNING_RATE);
+RailCalibration railCalibration({{HOME_POSITION_CM, COLUMN_1_DISTANCE_CM,
+                                  COLUMN_2_DISTANCE_CM, COLUMN_3_DISTANCE_CM},
+                                 MOTOR_MIN_SPEED, MOTOR_MIN_SPEED,
+                                 MOTOR_CM_S_PER_PERCENT, MOTOR_CM_S_PER_PERCENT});
+FlashStore railCalibrationStore(FLASH_SECTOR_RAIL_CAL);
+MotionController motionController(ultrasonic, positionFilter, positionController, motionPlanner);
+constexpr ServoPulseTable boxServoPulses(BOX_SERVO_PULSE_0_US, BOX_SERVO_PULSE_90_US,
+                                         BOX_SERVO_PULSE_180_US);
+constexpr ServoPulseTable lidServoPulses(LID_SERVO_PULSE_0_US, LID_SERVO_PULSE_90_US,
+                                         LID_SERVO_PULSE_180_US);
+ServoController boxServo(SERVO_BOX_PIN, boxServoPulses);           // Servo #1 - Drop gate
+ServoController boardLidServo(SERVO_BOARD_LID_PIN, lidServoPulses); // Servo #2 - Board reset
+ServoGroup servos;                                  // Updates both servos once per frame
+ServoController::Trajectory servoTrajectory;        // Scratch buffer for playServoMove()
 
 Buzzer buzzer(BUZZER_PIN);
 
@@ -61,6 +98,7 @@ PushButton column3Button(BUTTON_COLUMN_3_PIN);
 PushButton dropButton(BUTTON_DROP_PIN);
 PushButton confirmButton(BUTTON_CONFIRM_PIN);
 PushButton startOverButton(BUTTON_START_OVER_PIN);
+LimitSwitch homeSwitch(LIMIT_SWITCH_PIN);
 
 // ============================================================================
 // GLOBAL VARIABLES
@@ -69,27 +107,53 @@ PushButton startOverButton(BUTTON_START_OVER_PIN);
 GameState currentState = STATE_INIT;
 uint8_t columnCounters[3] = {0, 0, 0};  // C1, C2, C3
 uint8_t selectedColumn = 0;              // 0=none, 1=col1, 2=col2, 3=col3
-float currentPosition = HOME_POSITION_CM; // Track current box position
+float positionTolerance = DISTANCE_TOLERANCE_CM; // Tightened when the sensor is calibrated
 char enteredCode[5] = "";                // Keypad input buffer
 uint8_t codeIndex = 0;
 bool isUnlocked = false;
 bool gameStarted = false;
 
+// Drop/reset sequences advance one step per main-loop pass
+enum SequenceStep {
+    SEQ_OPENING,  // Servo opening
+    SEQ_HOLDING,  // Open, waiting for pieces to fall
+    SEQ_CLOSING   // Servo(s) closing
+};
+SequenceStep sequenceStep = SEQ_OPENING;
+uint32_t sequenceStepTime = 0;           // When SEQ_HOLDING started (ms)
+
 // ============================================================================
 // FUNCTION DECLARATIONS
 // ============================================================================
 
 void initializeHardware();
 void updateButtons();
+void clearButtonEvents();
+void serviceBackgroundTasks();
+void loadSensorCalibration();
+void runSensorCalibration();
+int8_t jogToStop(const char* name, float distance);
+uint8_t averageEchoes(uint32_t* echoUs, float* distanceCm);
+void loadRailCalibration();
+void applyRailCalibration();
+bool runRailCalibration();
+bool waitForMove();
+uint8_t findMinimumDuty(MotorDriver::Direction direction);
+float measureVelocity(uint8_t duty, MotorDriver::Direction direction, float limit);
 void printGameStatus();
 bool allColumnsComplete();
 bool isColumnEnabled(uint8_t column);
 float getTargetDistance(uint8_t column);
-bool moveToColumn(uint8_t column);
-void executeDropSequence();
+void beginMoveToColumn(uint8_t column);
+void beginDropSequence();
+bool updateDropSequence();
 void executeWinSequence();
-void executeResetSequence();
-void returnToHome();
+void beginResetSequence();
+bool updateResetSequence();
+void beginReturnToHome();
+void playServoMove(ServoController& servo, float angle, uint32_t duration_ms);
+void printMotionFailure(const char* what);
+void printMotionTelemetry();
 void handleKeypadInput();
 void handleButtonInput();
 void updateStateMachine();
@@ -113,6 +177,30 @@ int main() {
     // Initialize all hardware
     initializeHardware();
     
+    // Hold Confirm during power-up to capture a new sensor calibration
+    if (confirmButton.isPressed()) {
+        runSensorCalibration();
+    }
+    loadSensorCalibration();
+    
+    // Hold Start Over during power-up to re-measure the rail
+    loadRailCalibration();
+    if (startOverButton.isPressed() && runRailCalibration()) {
+        applyRailCalibration();
+    }
+    
+    // Without a home switch the carriage must be parked at home at power-up
+    if (LIMIT_SWITCH_INSTALLED) {
+        printf("→ Homing...\n");
+        motionController.requestHome();
+        if (waitForMove()) {
+            printf("✓ Homed\n");
+        } else {
+            printf("✗ Homing failed\n");
+            buzzer.playErrorBeep();
+        }
+    }
+    
     // Play startup sequence
     buzzer.playStartupSequence();
     printf("✓ System initialized!\n\n");
@@ -125,8 +213,7 @@ int main() {
         updateButtons();
         
         // Update servos
-        boxServo.update();
-        boardLidServo.update();
+        servos.update();
         
         // Update buzzer
         buzzer.update();
@@ -134,8 +221,8 @@ int main() {
         // Run state machine
         updateStateMachine();
         
-        // Small delay
-        sleep_ms(10);
+        // Small delay (short while moving so each ping is handled promptly)
+        sleep_ms(motionController.isActive() ? 1 : 10);
     }
     
     return 0;
@@ -152,13 +239,64 @@ void initializeHardware() {
     printf("  ✓ Keypad\n");
     
     ultrasonic.init();
-    printf("  ✓ Ultrasonic sensor\n");
+    ultrasonic.setMaxRange(ULTRASONIC_MAX_RANGE_CM);
+    printf("  ✓ Ultrasonic sensor (air %d°C)\n", ultrasonic.getTemperature());
     
     motor.init();
+    motor.setRampRate(MOTOR_RAMP_RATE);
+    motor.setBrakeMode(MOTOR_SHORT_BRAKE ? MotorDriver::SHORT_BRAKE : MotorDriver::COAST);
+    if (CURRENT_SENSE_INSTALLED) {
+        if (motor.initCurrentSense(MOTOR_SENSE_PIN, MOTOR_SENSE_OHMS)) {
+            motor.setCurrentLimits(MOTOR_OVERCURRENT_MA, MOTOR_STALL_MA, MOTOR_STALL_MS);
+        } else {
+            printf("  ✗ Current sense (no free DMA channel)\n");
+        }
+    }
+    positionController.setSpeedLimits(MOTOR_MIN_SPEED, MOTOR_SPEED);
+    positionController.setSlowdownDistance(POSITION_SLOWDOWN_CM);
+    positionController.setStopModel(&stopDistanceModel);
+    
+    // Plan every stop-to-stop move once (stop index = column, 0 = home)
+    const float stops[4] = {HOME_POSITION_CM, COLUMN_1_DISTANCE_CM,
+                            COLUMN_2_DISTANCE_CM, COLUMN_3_DISTANCE_CM};
+    motionController.setStops(stops, 4);
+    motionController.configure(MOTOR_TIMEOUT_MS, ULTRASONIC_PING_INTERVAL_MS,
+                               ULTRASONIC_WINDOW_MARGIN_CM, ULTRASONIC_OVERSHOOT_MARGIN_CM,
+                               FILTER_MIN_CONFIDENCE);
     printf("  ✓ Motor driver\n");
     
+    // Predict position between pings; an encoder (if fitted) takes over
+    positionObserver.setModel(MOTOR_CM_S_PER_PERCENT, MOTOR_CM_S_PER_PERCENT,
+                              MOTOR_MIN_SPEED, MOTOR_TIME_CONSTANT_MS);
+    motionController.setObserver(&positionObserver, CONTROL_PERIOD_US, OBSERVER_MAX_BLIND_PINGS);
+    
+    if (ENCODER_INSTALLED) {
+        if (encoder.init()) {
+            motionController.setEncoder(&encoder, &encoderFusion, CONTROL_PERIOD_US);
+            printf("  ✓ Encoder (%lu Hz control loop)\n", 1000000 / CONTROL_PERIOD_US);
+        } else {
+            printf("  ✗ Encoder (PIO unavailable, using dead reckoning)\n");
+        }
+    }
+    
+    if (LIMIT_SWITCH_INSTALLED) {
+        homeSwitch.init();
+        motionController.setLimitSwitch(&homeSwitch, LIMIT_SWITCH_POSITION_CM,
+                                        HOMING_FAST_SPEED, HOMING_SLOW_SPEED, HOMING_BACKOFF_MS);
+        printf("  ✓ Home limit switch\n");
+    }
+    
     boxServo.init();
     boardLidServo.init();
+    boxServo.setFrameSync(SERVO_FRAME_SYNC);
+    boardLidServo.setFrameSync(SERVO_FRAME_SYNC);
+    boxServo.setMotionModel(BOX_SERVO_SPEED_DEG_S, BOX_SERVO_SETTLE_MS);
+    boardLidServo.setMotionModel(LID_SERVO_SPEED_DEG_S, LID_SERVO_SETTLE_MS);
+    boxServo.setAutoDetach(SERVO_AUTO_DETACH_MS);
+    boardLidServo.setAutoDetach(SERVO_AUTO_DETACH_MS);
+    servos.add(boxServo);
+    servos.add(boardLidServo);
+    servos.setFrameSync(SERVO_FRAME_SYNC);
     printf("  ✓ Servos\n");
     
     buzzer.init();
@@ -170,6 +308,12 @@ void initializeHardware() {
     dropButton.init();
     confirmButton.init();
     startOverButton.init();
+    column1Button.setIrqMode(BUTTON_IRQ_MODE);
+    column2Button.setIrqMode(BUTTON_IRQ_MODE);
+    column3Button.setIrqMode(BUTTON_IRQ_MODE);
+    dropButton.setIrqMode(BUTTON_IRQ_MODE);
+    confirmButton.setIrqMode(BUTTON_IRQ_MODE);
+    startOverButton.setIrqMode(BUTTON_IRQ_MODE);
     printf("  ✓ Buttons\n");
     
     // Set initial servo positions (closed)
@@ -188,6 +332,401 @@ void updateButtons() {
     startOverButton.update();
 }
 
+void clearButtonEvents() {
+    column1Button.clearEvents();
+    column2Button.clearEvents();
+    column3Button.clearEvents();
+    dropButton.clearEvents();
+    confirmButton.clearEvents();
+    startOverButton.clearEvents();
+}
+
+void serviceBackgroundTasks() {
+    // Keep inputs, servos and buzzer alive during long operations
+    updateButtons();
+    servos.update();
+    buzzer.update();
+}
+
+// ============================================================================
+// SENSOR CALIBRATION
+// ============================================================================
+
+void loadSensorCalibration() {
+    if (sensorCalibration.load(sensorCalibrationStore) && sensorCalibration.isValid()) {
+        ultrasonic.setCalibration(&sensorCalibration);
+        positionTolerance = DISTANCE_TOLERANCE_CALIBRATED_CM;
+        printf("✓ Sensor calibration loaded (%d points, tolerance %.1f cm)\n",
+               sensorCalibration.getPointCount(), positionTolerance);
+    } else {
+        ultrasonic.setCalibration(nullptr);
+        positionTolerance = DISTANCE_TOLERANCE_CM;
+        printf("  No sensor calibration (tolerance %.1f cm)\n", positionTolerance);
+    }
+    
+    positionController.setSettleCriteria(positionTolerance, POSITION_SETTLE_VELOCITY_CM_S,
+                                         POSITION_SETTLE_MS);
+}
+
+int8_t jogToStop(const char* name, float distance) {
+    printf("→ Park the box at %s (%.1f cm) and press Confirm\n", name, distance);
+    
+    while (true) {
+        serviceBackgroundTasks();
+        
+        // Jog while a direction button is held
+        if (column1Button.isPressed()) {
+            motor.run(CALIBRATION_JOG_SPEED, MotorDriver::REVERSE);
+        } else if (column3Button.isPressed()) {
+            motor.run(CALIBRATION_JOG_SPEED, MotorDriver::FORWARD);
+        } else {
+            motor.stop();
+        }
+        
+        if (startOverButton.wasPressed()) {
+            motor.stop();
+            uint32_t pressTime = to_ms_since_boot(get_absolute_time());
+            while (startOverButton.isPressed()) {
+                serviceBackgroundTasks();
+                if (to_ms_since_boot(get_absolute_time()) - pressTime > 1000) {
+                    startOverButton.waitForRelease();
+                    return -1;  // Abort
+                }
+                sleep_ms(10);
+            }
+            printf("  Skipped %s\n", name);
+            return 0;
+        }
+        
+        if (confirmButton.wasPressed()) {
+            motor.stop();
+            sleep_ms(200);  // Let the carriage settle
+            return 1;
+        }
+        
+        sleep_ms(10);
+    }
+}
+
+uint8_t averageEchoes(uint32_t* echoUs, float* distanceCm) {
+    // Average the temperature-normalised echo and distance over several pings
+    uint32_t echoSum = 0;
+    float distanceSum = 0.0f;
+    uint8_t echoCount = 0;
+    for (uint8_t i = 0; i < CALIBRATION_SAMPLES; i++) {
+        float distance = ultrasonic.measureDistance();
+        if (distance >= 0.0f) {
+            echoSum += ultrasonic.getLastReferenceEchoUs();
+            distanceSum += distance;
+            echoCount++;
+        }
+        sleep_ms(ULTRASONIC_PING_INTERVAL_MS);
+    }
+    
+    if (echoCount > 0) {
+        if (echoUs != nullptr) {
+            *echoUs = echoSum / echoCount;
+        }
+        if (distanceCm != nullptr) {
+            *distanceCm = distanceSum / echoCount;
+        }
+    }
+    return echoCount;
+}
+
+void runSensorCalibration() {
+    const char* stopNames[4] = {"HOME", "COLUMN 1", "COLUMN 2", "COLUMN 3"};
+    const float stopDistances[4] = {HOME_POSITION_CM, COLUMN_1_DISTANCE_CM,
+                                    COLUMN_2_DISTANCE_CM, COLUMN_3_DISTANCE_CM};
+    
+    printf("\n=== SENSOR CALIBRATION ===\n");
+    printf("Jog with Column 1 (toward sensor) / Column 3 (away from sensor).\n");
+    printf("Confirm = capture point, Start Over = skip point (hold 1s to abort).\n");
+    
+    // Capture raw echoes, not previously corrected distances
+    ultrasonic.setCalibration(nullptr);
+    sensorCalibration.clear();
+    
+    confirmButton.waitForRelease();
+    
+    for (uint8_t stop = 0; stop < 4; stop++) {
+        bool captured = false;
+        while (!captured) {
+            int8_t result = jogToStop(stopNames[stop], stopDistances[stop]);
+            if (result < 0) {
+                printf("✗ Calibration aborted, flash unchanged\n");
+                buzzer.playErrorBeep();
+                return;
+            }
+            if (result == 0) {
+                break;
+            }
+            
+            uint32_t echo = 0;
+            uint8_t echoCount = averageEchoes(&echo, nullptr);
+            if (echoCount < CALIBRATION_SAMPLES / 2) {
+                printf("  ✗ Too few echoes (%d), try again\n", echoCount);
+                buzzer.playErrorBeep();
+                continue;
+            }
+            
+            sensorCalibration.addPoint(echo, (int32_t)(stopDistances[stop] * 10000.0f));
+            printf("  ✓ %s: %lu us -> %.1f cm\n", stopNames[stop], echo, stopDistances[stop]);
+            buzzer.playConfirmBeep();
+            captured = true;
+        }
+    }
+    
+    motor.stop();
+    
+    if (!sensorCalibration.isValid()) {
+        printf("✗ Need at least 2 points, flash unchanged\n");
+        buzzer.playErrorBeep();
+        return;
+    }
+    
+    if (sensorCalibration.save(sensorCalibrationStore)) {
+        printf("✓ Calibration saved (%d points)\n\n", sensorCalibration.getPointCount());
+    } else {
+        printf("✗ Calibration save failed\n\n");
+        buzzer.playErrorBeep();
+    }
+}
+
+// ============================================================================
+// RAIL CALIBRATION
+// ============================================================================
+
+void applyRailCalibration() {
+    const RailCalibration::Data& rail = railCalibration.data();
+    
+    uint8_t minDuty = rail.min_duty_forward > rail.min_duty_reverse
+                      ? rail.min_duty_forward : rail.min_duty_reverse;
+    
+    // Cruise duty reaches the profile velocity, with headroom for corrections
+    uint16_t maxDuty = railCalibration.dutyForVelocity(MOTION_MAX_VELOCITY_CM_S, true);
+    uint16_t reverseDuty = railCalibration.dutyForVelocity(MOTION_MAX_VELOCITY_CM_S, false);
+    if (reverseDuty > maxDuty) {
+        maxDuty = reverseDuty;
+    }
+    maxDuty += MOTOR_SPEED_HEADROOM;
+    if (maxDuty > 100) {
+        maxDuty = 100;
+    }
+    
+    positionController.setSpeedLimits(minDuty, (uint8_t)maxDuty);
+    positionController.setFeedforward(2.0f / (rail.gain_forward + rail.gain_reverse), minDuty);
+    positionObserver.setModel(rail.gain_forward, rail.gain_reverse, minDuty,
+                              MOTOR_TIME_CONSTANT_MS);
+    motionController.setStops(rail.stops_cm, RailCalibration::NUM_STOPS);
+}
+
+void loadRailCalibration() {
+    if (railCalibration.load(railCalibrationStore)) {
+        const RailCalibration::Data& rail = railCalibration.data();
+        printf("✓ Rail calibration loaded (stops %.1f/%.1f/%.1f/%.1f cm, min duty %d/%d%%)\n",
+               rail.stops_cm[0], rail.stops_cm[1], rail.stops_cm[2], rail.stops_cm[3],
+               rail.min_duty_forward, rail.min_duty_reverse);
+        applyRailCalibration();
+    } else {
+        printf("  No rail calibration (using config.h defaults)\n");
+    }
+}
+
+bool waitForMove() {
+    while (motionController.update() == MotionController::MOVING) {
+        serviceBackgroundTasks();
+        sleep_ms(1);
+    }
+    return motionController.state() == MotionController::ARRIVED;
+}
+
+uint8_t findMinimumDuty(MotorDriver::Direction direction) {
+    float start = 0.0f;
+    if (averageEchoes(nullptr, &start) == 0) {
+        return 0;
+    }
+    
+    // Raise duty slowly until the carriage visibly moves
+    for (uint8_t duty = 0; duty <= 100; duty++) {
+        motor.run(duty, direction);
+        sleep_ms(RAIL_CAL_DUTY_STEP_MS);
+        
+        float distance = ultrasonic.measureDistance();
+        if (distance >= 0.0f &&
+            (distance - start > RAIL_CAL_MOVE_THRESHOLD_CM ||
+             start - distance > RAIL_CAL_MOVE_THRESHOLD_CM)) {
+            motor.stop();
+            return duty;
+        }
+    }
+    
+    motor.stop();
+    return 0;
+}
+
+float measureVelocity(uint8_t duty, MotorDriver::Direction direction, float limit) {
+    // Least-squares slope of position over time while cruising
+    float sumT = 0.0f, sumX = 0.0f, sumTT = 0.0f, sumTX = 0.0f;
+    uint8_t count = 0;
+    
+    motor.run(duty, direction);
+    uint32_t startTime = time_us_32();
+    
+    while ((time_us_32() - startTime) < MOTOR_TIMEOUT_MS * 1000) {
+        float distance = ultrasonic.measureDistance();
+        float t = (time_us_32() - startTime) / 1000000.0f;
+        
+        if (distance >= 0.0f) {
+            bool pastLimit = (direction == MotorDriver::FORWARD) ? distance >= limit
+                                                                 : distance <= limit;
+            if (pastLimit) {
+                break;
+            }
+            
+            // Skip the spin-up
+            if (t * 1000.0f >= RAIL_CAL_SETTLE_MS) {
+                sumT += t;
+                sumX += distance;
+                sumTT += t * t;
+                sumTX += t * distance;
+                count++;
+            }
+        }
+        sleep_ms(ULTRASONIC_PING_INTERVAL_MS);
+    }
+    
+    motor.stop();
+    sleep_ms(300);  // Let the carriage stop
+    
+    float denominator = count * sumTT - sumT * sumT;
+    if (count < RAIL_CAL_MIN_SAMPLES || denominator <= 0.0f) {
+        return 0.0f;  // Too fast for the rail length
+    }
+    
+    float slope = (count * sumTX - sumT * sumX) / denominator;
+    return slope < 0.0f ? -slope : slope;
+}
+
+bool runRailCalibration() {
+    const char* stopNames[4] = {"HOME", "COLUMN 1", "COLUMN 2", "COLUMN 3"};
+    RailCalibration::Data& rail = railCalibration.data();
+    const RailCalibration::Data previous = rail;
+    
+    printf("\n=== RAIL CALIBRATION ===\n");
+    printf("Step 1: mark the stops. Jog with Column 1 / Column 3, Confirm to mark.\n");
+    printf("Start Over = keep current value (hold 1s to abort).\n");
+    
+    startOverButton.waitForRelease();
+    startOverButton.wasPressed();
+    
+    // 1. Stops, as the sensor sees them
+    for (uint8_t stop = 0; stop < RailCalibration::NUM_STOPS; stop++) {
+        bool marked = false;
+        while (!marked) {
+            int8_t result = jogToStop(stopNames[stop], rail.stops_cm[stop]);
+            if (result < 0) {
+                printf("✗ Calibration aborted, flash unchanged\n");
+                buzzer.playErrorBeep();
+                rail = previous;
+                return false;
+            }
+            if (result == 0) {
+                break;
+            }
+            
+            float distance = 0.0f;
+            if (averageEchoes(nullptr, &distance) < CALIBRATION_SAMPLES / 2) {
+                printf("  ✗ Too few echoes, try again\n");
+                buzzer.playErrorBeep();
+                continue;
+            }
+            
+            rail.stops_cm[stop] = distance;
+            printf("  ✓ %s at %.2f cm\n", stopNames[stop], distance);
+            buzzer.playConfirmBeep();
+            marked = true;
+        }
+    }
+    
+    // 2. Minimum duty: reverse from the far end, then forward from home
+    printf("Step 2: measuring minimum duty...\n");
+    motionController.setStops(rail.stops_cm, RailCalibration::NUM_STOPS);
+    motionController.requestHome();
+    waitForMove();
+    motionController.requestMove(RailCalibration::NUM_STOPS - 1);
+    bool ready = waitForMove();
+    
+    rail.min_duty_reverse = ready ? findMinimumDuty(MotorDriver::REVERSE) : 0;
+    motionController.requestHome();
+    ready = waitForMove() && ready;
+    rail.min_duty_forward = ready ? findMinimumDuty(MotorDriver::FORWARD) : 0;
+    printf("  Forward %d%%, reverse %d%%\n", rail.min_duty_forward, rail.min_duty_reverse);
+    
+    // 3. Velocity at each duty, sweeping forward and back between the end stops
+    printf("Step 3: measuring velocity per duty...\n");
+    uint8_t duties[RAIL_CAL_MAX_POINTS];
+    float forwardVelocities[RAIL_CAL_MAX_POINTS];
+    float reverseVelocities[RAIL_CAL_MAX_POINTS];
+    uint8_t points = 0;
+    
+    uint8_t minDuty = rail.min_duty_forward > rail.min_duty_reverse
+                      ? rail.min_duty_forward : rail.min_duty_reverse;
+    float low = rail.stops_cm[0];
+    float high = rail.stops_cm[RailCalibration::NUM_STOPS - 1];
+    
+    for (uint16_t duty = minDuty + RAIL_CAL_DUTY_INCREMENT;
+         ready && duty <= 100 && points < RAIL_CAL_MAX_POINTS;
+         duty += RAIL_CAL_DUTY_INCREMENT) {
+        motionController.requestHome();
+        if (!waitForMove()) {
+            break;
+        }
+        
+        float forward = measureVelocity(duty, MotorDriver::FORWARD, high);
+        float reverse = measureVelocity(duty, MotorDriver::REVERSE, low);
+        if (forward <= 0.0f || reverse <= 0.0f) {
+            break;  // Faster duties would not fit the rail either
+        }
+        
+        duties[points] = duty;
+        forwardVelocities[points] = forward;
+        reverseVelocities[points] = reverse;
+        points++;
+        printf("  %3d%%: forward %.1f cm/s, reverse %.1f cm/s\n", duty, forward, reverse);
+    }
+    
+    rail.gain_forward = RailCalibration::fitGain(duties, forwardVelocities, points,
+                                                 rail.min_duty_forward);
+    rail.gain_reverse = RailCalibration::fitGain(duties, reverseVelocities, points,
+                                                 rail.min_duty_reverse);
+    
+    motionController.requestHome();
+    waitForMove();
+    
+    if (!railCalibration.isValid() || rail.min_duty_forward == 0 || rail.min_duty_reverse == 0) {
+        printf("✗ Rail calibration failed, flash unchanged\n\n");
+        buzzer.playErrorBeep();
+        rail = previous;
+        motionController.setStops(rail.stops_cm, RailCalibration::NUM_STOPS);
+        return false;
+    }
+    
+    printf("  Gain forward %.3f, reverse %.3f cm/s per %%\n",
+           rail.gain_forward, rail.gain_reverse);
+    
+    if (!railCalibration.save(railCalibrationStore)) {
+        printf("✗ Rail calibration save failed\n\n");
+        buzzer.playErrorBeep();
+        rail = previous;  // Keep running on what is stored
+        motionController.setStops(rail.stops_cm, RailCalibration::NUM_STOPS);
+        return false;
+    }
+    
+    printf("✓ Rail calibration saved\n\n");
+    return true;
+}
+
 // ============================================================================
 // GAME LOGIC HELPERS
 // ============================================================================
@@ -215,146 +754,106 @@ bool isColumnEnabled(uint8_t column) {
 }
 
 float getTargetDistance(uint8_t column) {
-    switch (column) {
-        case 1: return COLUMN_1_DISTANCE_CM;
-        case 2: return COLUMN_2_DISTANCE_CM;
-        case 3: return COLUMN_3_DISTANCE_CM;
-        default: return HOME_POSITION_CM;
+    // Stop index matches column number (0 = home)
+    if (column >= RailCalibration::NUM_STOPS) {
+        column = 0;
     }
+    return railCalibration.data().stops_cm[column];
 }
 
 // ============================================================================
 // MOVEMENT FUNCTIONS
 // ============================================================================
 
-bool moveToColumn(uint8_t column) {
-    float targetDistance = getTargetDistance(column);
-    
-    printf("→ Moving to Column %d (current: %.1f cm, target: %.1f cm)...\n", 
-           column, currentPosition, targetDistance);
-    
-    // Determine direction based on current vs target position
-    MotorDriver::Direction direction;
-    if (targetDistance > currentPosition) {
-        direction = MotorDriver::FORWARD;  // Move away from sensor (increase distance)
-        printf("  Direction: FORWARD (moving right)\n");
-    } else if (targetDistance < currentPosition) {
-        direction = MotorDriver::REVERSE;  // Move toward sensor (decrease distance)
-        printf("  Direction: REVERSE (moving left)\n");
-    } else {
-        printf("  Already at target position!\n");
-        return true;
-    }
-    
-    // Start motor in appropriate direction
-    motor.run(MOTOR_SPEED, direction);
-    
-    uint32_t startTime = to_ms_since_boot(get_absolute_time());
-    bool positionReached = false;
-    
-    while (!positionReached) {
-        // Check timeout
-        if ((to_ms_since_boot(get_absolute_time()) - startTime) > MOTOR_TIMEOUT_MS) {
-            motor.stop();
-            printf("✗ Movement timeout!\n");
-            buzzer.playErrorBeep();
-            return false;
-        }
-        
-        // Measure current distance
-        float measuredDistance = ultrasonic.measureDistance();
-        
-        if (measuredDistance >= 0) {
-            printf("  Current: %.1f cm | Target: %.1f cm\n", measuredDistance, targetDistance);
-            
-            // Check if we've reached the target (within tolerance)
-            if (measuredDistance >= targetDistance - DISTANCE_TOLERANCE_CM &&
-                measuredDistance <= targetDistance + DISTANCE_TOLERANCE_CM) {
-                positionReached = true;
-                currentPosition = measuredDistance;  // Update tracked position
-            }
-            // Check if we've overshot (moved past target)
-            else if (direction == MotorDriver::FORWARD && 
-                     measuredDistance > targetDistance + DISTANCE_TOLERANCE_CM) {
-                printf("  Overshot target, stopping.\n");
-                positionReached = true;
-                currentPosition = measuredDistance;
-            }
-            else if (direction == MotorDriver::REVERSE && 
-                     measuredDistance < targetDistance - DISTANCE_TOLERANCE_CM) {
-                printf("  Overshot target, stopping.\n");
-                positionReached = true;
-                currentPosition = measuredDistance;
-            }
-        }
-        
-        sleep_ms(100);  // Check every 100ms
-    }
+void beginMoveToColumn(uint8_t column) {
+    printf("→ Moving to Column %d (current: %.1f cm, target: %.1f cm)...\n",
+           column, motionController.getPosition(), getTargetDistance(column));
     
-    motor.stop();
-    printf("✓ Position reached! Box at %.1f cm\n", currentPosition);
-    buzzer.playConfirmBeep();
-    return true;
+    // Stop index matches column number (0 = home)
+    motionController.requestMove(column);
+    currentState = STATE_MOVING_TO_COLUMN;
 }
 
-void returnToHome() {
+void beginReturnToHome() {
     printf("→ Returning to home position...\n");
+    motionController.requestHome();
+    currentState = STATE_RETURNING_HOME;
+}
+
+void printMotionTelemetry() {
+    static uint32_t lastPrintTime = 0;
+    uint32_t now = to_ms_since_boot(get_absolute_time());
     
-    // Move in reverse to home
-    motor.run(MOTOR_SPEED, MotorDriver::REVERSE);
-    
-    uint32_t startTime = to_ms_since_boot(get_absolute_time());
-    bool homeReached = false;
-    
-    while (!homeReached) {
-        if ((to_ms_since_boot(get_absolute_time()) - startTime) > MOTOR_TIMEOUT_MS) {
-            motor.stop();
-            printf("✗ Home timeout!\n");
-            buzzer.playErrorBeep();
-            return;
-        }
-        
-        float currentDistance = ultrasonic.measureDistance();
-        
-        if (currentDistance >= 0) {
-            if (currentDistance <= HOME_POSITION_CM + DISTANCE_TOLERANCE_CM) {
-                homeReached = true;
-            }
-        }
-        
-        sleep_ms(100);
+    if ((now - lastPrintTime) >= MOTION_TELEMETRY_INTERVAL_MS) {
+        const DistanceEstimate& estimate = motionController.getEstimate();
+        printf("  Current: %.1f cm (%.1f cm/s) | Out: %.0f%% | Motor: %u mA | ETA: %ld ms\n",
+               estimate.position_cm, estimate.velocity_cm_s, positionController.getOutput(),
+               motor.getCurrentMa(), motionController.getPredictedArrivalUs() / 1000);
+        lastPrintTime = now;
     }
+}
+
+void printMotionFailure(const char* what) {
+    uint8_t events = motionController.getMotorEvents();
     
-    motor.stop();
-    printf("✓ Home position reached!\n");
+    if (events & MotorDriver::CURRENT_OVERLOAD) {
+        printf("✗ %s aborted: motor overcurrent (%u mA)!\n", what, motor.getCurrentMa());
+    } else if (events & MotorDriver::CURRENT_STALL) {
+        printf("✗ %s aborted: carriage jammed (%u mA)!\n", what, motor.getCurrentMa());
+    } else {
+        printf("✗ %s timeout!\n", what);
+    }
 }
 
 // ============================================================================
 // GAME SEQUENCES
 // ============================================================================
 
-void executeDropSequence() {
+void playServoMove(ServoController& servo, float angle, uint32_t duration_ms) {
+    // DMA playback needs no CPU; fall back to interpolation if no channel is free.
+    // Returns at once: callers poll servo.isMoving() from the state machine.
+    servo.planMove(servoTrajectory, servo.getCurrentAngle(), angle, duration_ms);
+    if (!servo.play(servoTrajectory)) {
+        servo.moveToAngle(angle, duration_ms);
+    }
+}
+
+void beginDropSequence() {
     printf("\n▼ EXECUTING DROP SEQUENCE ▼\n");
     printf("Opening box gate...\n");
     
     // Open the box servo
-    boxServo.moveToAngle(BOX_OPEN_ANGLE, 500);
-    while (boxServo.isMoving()) {
-        boxServo.update();
-        sleep_ms(10);
-    }
-    
-    printf("Gate open - piece dropping for %lu seconds...\n", BOX_DROP_TIME_MS / 1000);
-    
-    // Keep gate open for specified time
-    sleep_ms(BOX_DROP_TIME_MS);
+    playServoMove(boxServo, BOX_OPEN_ANGLE, 500);
+    sequenceStep = SEQ_OPENING;
+    currentState = STATE_DROPPING;
+}
+
+bool updateDropSequence() {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
     
-    // Close the box servo
-    printf("Closing gate...\n");
-    boxServo.moveToAngle(BOX_CLOSED_ANGLE, 500);
-    while (boxServo.isMoving()) {
-        boxServo.update();
-        sleep_ms(10);
+    switch (sequenceStep) {
+        case SEQ_OPENING:
+            if (!boxServo.isMoving()) {
+                printf("Gate open - piece dropping for %lu seconds...\n", BOX_DROP_TIME_MS / 1000);
+                sequenceStep = SEQ_HOLDING;
+                sequenceStepTime = now;
+            }
+            return false;
+            
+        case SEQ_HOLDING:
+            // Keep gate open for specified time
+            if ((now - sequenceStepTime) >= BOX_DROP_TIME_MS) {
+                printf("Closing gate...\n");
+                playServoMove(boxServo, BOX_CLOSED_ANGLE, 500);
+                sequenceStep = SEQ_CLOSING;
+            }
+            return false;
+            
+        case SEQ_CLOSING:
+            if (boxServo.isMoving()) {
+                return false;
+            }
+            break;
     }
     
     // Increment counter
@@ -369,6 +868,7 @@ void executeDropSequence() {
     if (columnCounters[selectedColumn - 1] >= MAX_PIECES_PER_COLUMN) {
         printf("⚠ Column %d is now FULL (disabled)\n", selectedColumn);
     }
+    return true;
 }
 
 void executeWinSequence() {
@@ -389,26 +889,44 @@ void executeWinSequence() {
     printf("The final escape is yours! 🎉\n\n");
 }
 
-void executeResetSequence() {
+void beginResetSequence() {
     printf("\n▼ EXECUTING RESET SEQUENCE ▼\n");
     printf("Opening board bottom lid...\n");
     
     // Open the board lid servo
-    boardLidServo.moveToAngle(LID_OPEN_ANGLE, 1000);
-    while (boardLidServo.isMoving()) {
-        boardLidServo.update();
-        sleep_ms(10);
-    }
-    
-    printf("Lid open - all pieces falling out...\n");
-    sleep_ms(3000);  // Wait for pieces to fall
+    playServoMove(boardLidServo, LID_OPEN_ANGLE, 1000);
+    sequenceStep = SEQ_OPENING;
+    currentState = STATE_RESET;
+}
+
+bool updateResetSequence() {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
     
-    // Close the board lid
-    printf("Closing board lid...\n");
-    boardLidServo.moveToAngle(LID_CLOSED_ANGLE, 1000);
-    while (boardLidServo.isMoving()) {
-        boardLidServo.update();
-        sleep_ms(10);
+    switch (sequenceStep) {
+        case SEQ_OPENING:
+            if (!boardLidServo.isMoving()) {
+                printf("Lid open - all pieces falling out...\n");
+                sequenceStep = SEQ_HOLDING;
+                sequenceStepTime = now;
+            }
+            return false;
+            
+        case SEQ_HOLDING:
+            // Wait for pieces to fall, then close the board lid (and make
+            // sure the box gate is shut for the new game)
+            if ((now - sequenceStepTime) >= 3000) {
+                printf("Closing board lid...\n");
+                const float closedAngles[] = {BOX_CLOSED_ANGLE, LID_CLOSED_ANGLE};  // servos add() order
+                servos.moveTo(closedAngles, 1000);
+                sequenceStep = SEQ_CLOSING;
+            }
+            return false;
+            
+        case SEQ_CLOSING:
+            if (servos.isMoving()) {
+                return false;
+            }
+            break;
     }
     
     // Reset all counters
@@ -421,6 +939,7 @@ void executeResetSequence() {
     buzzer.playConfirmBeep();
     
     printGameStatus();
+    return true;
 }
 
 // ============================================================================
@@ -467,19 +986,19 @@ void handleButtonInput() {
             selectedColumn = 1;
             printf("\n► Column 1 selected\n");
             buzzer.playConfirmBeep();
-            currentState = STATE_MOVING_TO_COLUMN;
+            beginMoveToColumn(selectedColumn);
         }
         else if (column2Button.wasPressed() && isColumnEnabled(2)) {
             selectedColumn = 2;
             printf("\n► Column 2 selected\n");
             buzzer.playConfirmBeep();
-            currentState = STATE_MOVING_TO_COLUMN;
+            beginMoveToColumn(selectedColumn);
         }
         else if (column3Button.wasPressed() && isColumnEnabled(3)) {
             selectedColumn = 3;
             printf("\n► Column 3 selected\n");
             buzzer.playConfirmBeep();
-            currentState = STATE_MOVING_TO_COLUMN;
+            beginMoveToColumn(selectedColumn);
         }
         else if (column1Button.wasPressed() && !isColumnEnabled(1)) {
             printf("✗ Column 1 is full!\n");
@@ -497,7 +1016,7 @@ void handleButtonInput() {
     
     // Drop button
     if (currentState == STATE_POSITIONED && dropButton.wasPressed()) {
-        currentState = STATE_DROPPING;
+        beginDropSequence();
     }
     
     // Confirm button (win)
@@ -507,7 +1026,7 @@ void handleButtonInput() {
     
     // Start Over button (reset)
     if (currentState == STATE_COMPLETE && startOverButton.wasPressed()) {
-        currentState = STATE_RESET;
+        beginResetSequence();
     }
 }
 
@@ -517,6 +1036,16 @@ void handleButtonInput() {
 // ============================================================================
 
 void updateStateMachine() {
+    // States waiting for a button only act on presses made after they began
+    static GameState previousState = STATE_INIT;
+    if (currentState != previousState) {
+        if (currentState == STATE_IDLE || currentState == STATE_POSITIONED ||
+            currentState == STATE_COMPLETE) {
+            clearButtonEvents();
+        }
+        previousState = currentState;
+    }
+    
     switch (currentState) {
         case STATE_INIT:
             // Initialization complete, move to locked state
@@ -572,16 +1101,46 @@ void updateStateMachine() {
             break;
             
         case STATE_MOVING_TO_COLUMN:
-            // Move box to selected column
-            if (moveToColumn(selectedColumn)) {
-                printf("✓ Ready to drop into Column %d\n", selectedColumn);
-                printf("Press DROP button to release piece...\n");
-                currentState = STATE_POSITIONED;
-            } else {
-                printf("✗ Failed to reach column position\n");
-                selectedColumn = 0;
-                returnToHome();
-                currentState = STATE_IDLE;
+            // Advance the move one step; inputs and audio keep running
+            switch (motionController.update()) {
+                case MotionController::ARRIVED:
+                    printf("✓ Position reached! Box at %.1f cm\n", motionController.getPosition());
+                    buzzer.playConfirmBeep();
+                    printf("✓ Ready to drop into Column %d\n", selectedColumn);
+                    printf("Press DROP button to release piece...\n");
+                    currentState = STATE_POSITIONED;
+                    break;
+                    
+                case MotionController::FAILED:
+                    printMotionFailure("Movement");
+                    buzzer.playErrorBeep();
+                    printf("✗ Failed to reach column position\n");
+                    selectedColumn = 0;
+                    beginReturnToHome();
+                    break;
+                    
+                default:
+                    printMotionTelemetry();
+                    break;
+            }
+            break;
+            
+        case STATE_RETURNING_HOME:
+            switch (motionController.update()) {
+                case MotionController::ARRIVED:
+                    printf("✓ Home position reached!\n");
+                    currentState = STATE_IDLE;
+                    break;
+                    
+                case MotionController::FAILED:
+                    printMotionFailure("Home");
+                    buzzer.playErrorBeep();
+                    currentState = STATE_IDLE;
+                    break;
+                    
+                default:
+                    printMotionTelemetry();
+                    break;
             }
             break;
             
@@ -591,8 +1150,10 @@ void updateStateMachine() {
             break;
             
         case STATE_DROPPING:
-            // Execute drop sequence
-            executeDropSequence();
+            // Advance the drop sequence (servos move in the background)
+            if (!updateDropSequence()) {
+                break;
+            }
             
             // Box stays at current column for efficiency
             // No need to return home between drops
@@ -634,8 +1195,10 @@ void updateStateMachine() {
             break;
             
         case STATE_RESET:
-            // Execute reset sequence
-            executeResetSequence();
+            // Advance the reset sequence (servos move in the background)
+            if (!updateResetSequence()) {
+                break;
+            }
             
             // Return to idle state
             currentState = STATE_IDLE;